@@ -10,15 +10,24 @@
 namespace eosiosystem::block_info {
 
 static constexpr uint32_t rolling_window_size = 10;
+static_assert(rolling_window_size > 0, "rolling window must hold at least one block");
+
+/**
+ * Version of the records written into the fixed slots of the rolling window.
+ *
+ * Version 0 records were keyed by block height and pruned as they fell out of the window. They are only found in a
+ * blockinfo table that was populated by an older system contract and are erased as the slots are first filled.
+ */
+static constexpr uint8_t slot_record_version = 1;
 
 /**
  * The blockinfo table holds a rolling window of records containing information for recent blocks.
  *
  * Each record stores the height and timestamp of the correspond block.
- * A record is added for a new block through the onblock action.
- * The onblock action also erases up to two old records at a time in an attempt to keep the table consisting of only
- * records for blocks going back a particular block height difference backward from the most recent block.
- * Currently that block height difference is hardcoded to 10.
+ * The window is stored in `rolling_window_size` fixed slots keyed by `block_height % rolling_window_size`. The onblock
+ * action overwrites the slot of the new block in place, so the record of the block that fell out of the window is
+ * replaced without a separate erase and a larger window costs no extra work per block.
+ * Currently the window size is hardcoded to 10.
  */
 struct [[eosio::table, eosio::contract("eosio.system")]] block_info_record
 {
@@ -26,13 +35,49 @@ struct [[eosio::table, eosio::contract("eosio.system")]] block_info_record
    uint32_t          block_height;
    eosio::time_point block_timestamp;
 
-   uint64_t primary_key() const { return block_height; }
+   uint64_t primary_key() const { return version == 0 ? block_height : slot_of(block_height); }
+
+   static uint64_t slot_of(uint32_t height) { return height % rolling_window_size; }
 
    EOSLIB_SERIALIZE(block_info_record, (version)(block_height)(block_timestamp))
 };
 
 using block_info_table = eosio::multi_index<"blockinfo"_n, block_info_record>;
 
+/**
+ * Batch sizes, in blocks, for which coarse summaries are kept beyond the rolling window: hourly and daily batches.
+ */
+static constexpr uint32_t summary_batch_sizes[] = {120, 7200};
+
+/**
+ * Number of batch starts kept for each summary batch size.
+ */
+static constexpr uint32_t summary_window_size = 24;
+
+/**
+ * The blocksummary table holds, for each size in `summary_batch_sizes`, the height and timestamp of the last
+ * `summary_window_size` blocks whose height is a multiple of that size.
+ *
+ * The table is scoped by the batch size and, like the blockinfo table, stores its records in fixed slots that are
+ * overwritten in place. The onblock action only writes to it on blocks that start a batch, so keeping the summaries
+ * costs at most one write per batch size per block.
+ */
+struct [[eosio::table("blocksummary"), eosio::contract("eosio.system")]] block_summary_record
+{
+   uint8_t           version = 0;
+   uint32_t          batch_size;
+   uint32_t          block_height;
+   eosio::time_point block_timestamp;
+
+   uint64_t primary_key() const { return slot_of(block_height, batch_size); }
+
+   static uint64_t slot_of(uint32_t height, uint32_t batch_size) { return (height / batch_size) % summary_window_size; }
+
+   EOSLIB_SERIALIZE(block_summary_record, (version)(batch_size)(block_height)(block_timestamp))
+};
+
+using block_summary_table = eosio::multi_index<"blocksummary"_n, block_summary_record>;
+
 struct block_batch_info
 {
    uint32_t          batch_start_height;
@@ -74,9 +119,13 @@ struct latest_block_batch_info_result
  * Note that the range spanning from the start to end block of the latest block batch may be less than batch_size
  * because latest block batch may be incomplete.
  * Also, it is possible for the record capturing info for the starting block to not exist in the blockinfo table. This
- * can either be due to the records being erased as they fall out of the rolling window or, in rare cases, due to gaps
+ * can either be due to the slots being overwritten as they fall out of the rolling window or, in rare cases, due to gaps
  * in block info records due to failures of the onblock action. In such a case, this function will be unable to return a
  * `block_batch_info` and will instead be forced to return the `insufficient_data` error code.
+ * When the starting block has already left the rolling window but its height is a multiple of one of the
+ * `summary_batch_sizes`, its record is taken from the blocksummary table instead. So batches aligned to those sizes,
+ * such as hourly batches with `batch_size` a multiple of 120 and `batch_start_height_offset` a multiple of 120, can be
+ * queried up to `summary_window_size` batches back.
  * Furthermore, if `batch_start_height_offset` is greater than the height of the latest block for which
  * information is recorded in the blockinfo table, there will be no latest block batch identified for the function to
  * return information about and so it will again be forced to return the `insufficient_data` error code instead.
@@ -94,20 +143,24 @@ latest_block_batch_info_result get_latest_block_batch_info(uint32_t    batch_sta
 
    block_info_table t(system_account_name, 0);
 
-   // Find information on latest block recorded in the blockinfo table.
+   // Find information on latest block recorded in the blockinfo table by scanning the slots of the rolling window.
 
-   if (t.cbegin() == t.cend()) {
-      // The blockinfo table is empty.
-      result.error_code = latest_block_batch_info_result::insufficient_data;
-      return result;
+   auto latest_block_info_itr = t.cend();
+   for (auto itr = t.cbegin(); itr != t.cend() && itr->primary_key() < rolling_window_size; ++itr) {
+      if (itr->version != slot_record_version) {
+         // Compiled code for this function within the calling contract has not been updated to support new version
+         // of the blockinfo table.
+         result.error_code = latest_block_batch_info_result::unsupported_version;
+         return result;
+      }
+      if (latest_block_info_itr == t.cend() || latest_block_info_itr->block_height < itr->block_height) {
+         latest_block_info_itr = itr;
+      }
    }
 
-   auto latest_block_info_itr = --t.cend();
-
-   if (latest_block_info_itr->version != 0) {
-      // Compiled code for this function within the calling contract has not been updated to support new version of
-      // the blockinfo table.
-      result.error_code = latest_block_batch_info_result::unsupported_version;
+   if (latest_block_info_itr == t.cend()) {
+      // The rolling window of the blockinfo table is empty.
+      result.error_code = latest_block_batch_info_result::insufficient_data;
       return result;
    }
 
@@ -141,34 +194,64 @@ latest_block_batch_info_result get_latest_block_batch_info(uint32_t    batch_sta
 
    // Find information on start block of the latest block batch recorded in the blockinfo table.
 
-   auto start_block_info_itr = t.find(latest_block_batch_start_height);
-   if (start_block_info_itr == t.cend() || start_block_info_itr->block_height != latest_block_batch_start_height) {
-      // Record for information on start block of the latest block batch could not be found in blockinfo table.
-      // This is either because of:
-      //    * a gap in recording info due to a failed onblock action;
-      //    * a requested start block that was processed by onblock prior to deployment of the system contract code
-      //    introducing the blockinfo table;
-      //    * or, most likely, because the record for the requested start block was pruned from the blockinfo table as
-      //    it fell out of the rolling window.
-      result.error_code = latest_block_batch_info_result::insufficient_data;
+   auto start_block_info_itr = t.find(block_info_record::slot_of(latest_block_batch_start_height));
+   if (start_block_info_itr != t.cend() && start_block_info_itr->block_height == latest_block_batch_start_height) {
+      if (start_block_info_itr->version != slot_record_version) {
+         // Compiled code for this function within the calling contract has not been updated to support new version
+         // of the blockinfo table.
+         result.error_code = latest_block_batch_info_result::unsupported_version;
+         return result;
+      }
+
+      result.result.emplace(block_batch_info{
+         .batch_start_height          = latest_block_batch_start_height,
+         .batch_start_timestamp       = start_block_info_itr->block_timestamp,
+         .batch_current_end_height    = latest_block_batch_end_height,
+         .batch_current_end_timestamp = latest_block_info_itr->block_timestamp,
+      });
       return result;
    }
 
-   if (start_block_info_itr->version != 0) {
-      // Compiled code for this function within the calling contract has not been updated to support new version of
-      // the blockinfo table.
-      result.error_code = latest_block_batch_info_result::unsupported_version;
+   // The start block is not in the rolling window. Look for it in the summaries of the batch sizes it is aligned to.
+
+   for (uint32_t summary_batch_size : summary_batch_sizes) {
+      if (latest_block_batch_start_height % summary_batch_size != 0) {
+         continue;
+      }
+
+      block_summary_table summaries(system_account_name, summary_batch_size);
+
+      auto summary_itr =
+         summaries.find(block_summary_record::slot_of(latest_block_batch_start_height, summary_batch_size));
+      if (summary_itr == summaries.cend() || summary_itr->block_height != latest_block_batch_start_height) {
+         continue;
+      }
+
+      if (summary_itr->version != 0) {
+         // Compiled code for this function within the calling contract has not been updated to support new version
+         // of the blocksummary table.
+         result.error_code = latest_block_batch_info_result::unsupported_version;
+         return result;
+      }
+
+      result.result.emplace(block_batch_info{
+         .batch_start_height          = latest_block_batch_start_height,
+         .batch_start_timestamp       = summary_itr->block_timestamp,
+         .batch_current_end_height    = latest_block_batch_end_height,
+         .batch_current_end_timestamp = latest_block_info_itr->block_timestamp,
+      });
       return result;
    }
 
-   // Successfully return block_batch_info for the found latest block batch in its current state.
-
-   result.result.emplace(block_batch_info{
-      .batch_start_height          = latest_block_batch_start_height,
-      .batch_start_timestamp       = start_block_info_itr->block_timestamp,
-      .batch_current_end_height    = latest_block_batch_end_height,
-      .batch_current_end_timestamp = latest_block_info_itr->block_timestamp,
-   });
+   // Record for information on start block of the latest block batch could not be found in blockinfo table.
+   // This is either because of:
+   //    * a gap in recording info due to a failed onblock action;
+   //    * a requested start block that was processed by onblock prior to deployment of the system contract code
+   //    introducing the blockinfo table;
+   //    * or, most likely, because the slot of the requested start block was overwritten by a later block as it
+   //    fell out of the rolling window and the start block is not aligned to a summarized batch size or has also
+   //    fallen out of the summary window.
+   result.error_code = latest_block_batch_info_result::insufficient_data;
    return result;
 }
 
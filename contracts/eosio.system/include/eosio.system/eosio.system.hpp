@@ -12,6 +12,7 @@
 #include <eosio.system/native.hpp>
 
 #include <deque>
+#include <map>
 #include <optional>
 #include <string>
 #include <type_traits>
@@ -73,6 +74,8 @@ namespace eosiosystem {
    static constexpr int64_t  inflation_pay_factor  = 5;                // 20% of the inflation
    static constexpr int64_t  votepay_factor        = 4;                // 25% of the producer pay
    static constexpr uint32_t refund_delay_sec      = 3 * seconds_per_day;
+   static constexpr uint32_t wps_votes_removed_per_action = 100; // voters cleaned up by one `rmvreject` or `rmvcompleted`
+   static constexpr uint32_t min_bid_prune_grace_sec = 7 * seconds_per_day; // shortest grace period `cfgbidprune` accepts
 
    static constexpr uint64_t useconds_in_gbm_period = 1096 * useconds_per_day;   // from July 1st 2019 to July 1st 2022
    static const time_point gbm_initial_time(eosio::seconds(1561939200));     // July 1st 2019 00:00:00
@@ -120,7 +123,7 @@ namespace eosiosystem {
      name            newname;
      name            high_bidder;
      int64_t         high_bid = 0; ///< negative high_bid == closed auction waiting to be claimed
-     time_point      last_bid_time;
+     time_point      last_bid_time; ///< time of the close once the auction is closed
 
      uint64_t primary_key()const { return newname.value;                    }
      uint64_t by_high_bid()const { return static_cast<uint64_t>(-high_bid); }
@@ -141,6 +144,15 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "bidrefunds"_n, bid_refund > bid_refund_table;
 
+   // Index of the bid refunds of a bidder, scoped by the bidder: one row per name it has a refund for
+   struct [[eosio::table, eosio::contract("eosio.system")]] bidder_refund {
+      name         newname;
+
+      uint64_t primary_key()const { return newname.value; }
+   };
+
+   typedef eosio::multi_index< "bidderrefund"_n, bidder_refund > bidder_refund_table;
+
    // Defines new global state parameters.
    struct [[eosio::table("global"), eosio::contract("eosio.system")]] eosio_global_state : eosio::blockchain_parameters {
       uint64_t free_ram()const { return max_ram_size - total_ram_bytes_reserved; }
@@ -197,6 +209,23 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
    };
 
+   // Defines new global state parameters added after version 3.1.0
+   struct [[eosio::table("global4"), eosio::contract("eosio.system")]] eosio_global_state4 {
+      eosio_global_state4() { }
+      bool              genesis_retired = false; ///< GBM is over and its state is being purged, `change_genesis` is a no-op
+      bool              powupresult_disabled = false; ///< `powerup` reports its result only through its return value
+      name              name_candidate; ///< open auction with the highest bid, the only one `onblock` may close next
+      int64_t           name_candidate_bid = 0; ///< high bid of `name_candidate`, 0 when there is no open auction
+      time_point        name_candidate_bid_time; ///< time of the high bid of `name_candidate`
+      bool              name_candidate_valid = false; ///< the candidate fields are in sync with the `namebids` table
+      uint32_t          bid_prune_grace_sec = 0; ///< closed auctions unclaimed for this long after their close can be pruned, 0 disables `prunebids`
+      bool              powerup_merge_orders = false; ///< `powerup` rounds expiries up to the day and merges orders per receiver and day
+
+      EOSLIB_SERIALIZE( eosio_global_state4, (genesis_retired)(powupresult_disabled)
+                        (name_candidate)(name_candidate_bid)(name_candidate_bid_time)(name_candidate_valid)
+                        (bid_prune_grace_sec)(powerup_merge_orders) )
+   };
+
    inline eosio::block_signing_authority convert_to_block_signing_authority( const eosio::public_key& producer_key ) {
       return eosio::block_signing_authority_v0{ .threshold = 1, .keys = {{producer_key, 1}} };
    }
@@ -335,6 +364,14 @@ namespace eosiosystem {
        EOSLIB_SERIALIZE( wps_voter, (owner)(proposals)(last_vote_weight))
    };
 
+   struct [[eosio::table, eosio::contract("eosio.system")]] wps_proposal_voter {
+       name voter;
+
+       uint64_t primary_key()const { return voter.value; }
+
+       EOSLIB_SERIALIZE( wps_proposal_voter, (voter))
+   };
+
 
     struct [[eosio::table, eosio::contract("eosio.system")]] proposer {
         name account;
@@ -374,6 +411,8 @@ namespace eosiosystem {
         uint64_t duration;            // duration
         vector<string> members;       // linkedin
         asset funding_goal;           // amount of EOS
+        // the fields below mirror `proposal_tally` as of the last status change or funding claim, `total_votes` is
+        // not refreshed by the votes in between. Read the live values from `proposal_tally`.
         double total_votes;         // total votes
         uint8_t status;               // status
         time_point_sec vote_start_time;     // time when voting starts (seconds)
@@ -382,11 +421,24 @@ namespace eosiosystem {
         uint32_t total_iterations; // total number of iterations
         uint64_t primary_key() const { return proposer.value; }
         uint64_t by_id() const { return id; }
-        double   by_votes()const    { return total_votes;  }
+        double   by_votes()const    { return total_votes;  } // votes as of the last status change, see `proposal_tally::by_votes`
         EOSLIB_SERIALIZE( proposal, (proposer)(id)(committee)(category)(subcategory)(title)(summary)(project_img_url)(description)(roadmap)(duration)(members)(funding_goal)
                 (total_votes)(status)(vote_start_time)(fund_start_time)(iteration_of_funding)(total_iterations) )
     };
 
+    struct [[eosio::table, eosio::contract("eosio.system")]] proposal_tally {
+        name proposer;        // proposer
+        double total_votes = 0;       // total votes
+        uint8_t status = 0;           // status
+        time_point_sec vote_start_time;     // time when voting starts (seconds)
+        time_point_sec fund_start_time;     // time when funding starts (seconds)
+        uint32_t iteration_of_funding = 1; // current number of iterations
+        uint32_t total_iterations = 0; // total number of iterations
+        uint64_t primary_key() const { return proposer.value; }
+        double   by_votes()const    { return total_votes;  }
+        EOSLIB_SERIALIZE( proposal_tally, (proposer)(total_votes)(status)(vote_start_time)(fund_start_time)(iteration_of_funding)(total_iterations) )
+    };
+
     struct [[eosio::table, eosio::contract("eosio.system")]] committee {
         name committeeman;
         string category;
@@ -432,13 +484,25 @@ namespace eosiosystem {
     /**
     * Proposals table
     *
-    * @details The proposals table stores all WPS proposal items
+    * @details The proposals table stores all WPS proposal items. Its `prototalvote` index orders proposals by
+    * their votes as of their last status change, use the index of the same name on the proposal tallies table
+    * for the live order.
     */
     typedef eosio::multi_index< "proposals"_n, proposal,
             indexed_by< "idx"_n, const_mem_fun<proposal, uint64_t, &proposal::by_id>  >,
             indexed_by<"prototalvote"_n, const_mem_fun<proposal, double, &proposal::by_votes>  >
     > proposal_table;
 
+    /**
+    * Proposal tallies table
+    *
+    * @details The proposal tallies table stores the votes, status and funding progress of each WPS proposal,
+    * apart from its description in the proposals table, so votes do not rewrite the description.
+    */
+    typedef eosio::multi_index< "proptally"_n, proposal_tally,
+            indexed_by<"prototalvote"_n, const_mem_fun<proposal_tally, double, &proposal_tally::by_votes>  >
+    > proposal_tally_table;
+
     /**
     * Committees table
     *
@@ -479,6 +543,16 @@ namespace eosiosystem {
      */
     typedef eosio::multi_index< "wpsvoters"_n, wps_voter >  wps_voters_table;
 
+    /**
+     * WPS proposal voters table
+     *
+     * @details The WPS proposal voters table, scoped by proposer, stores a `wps_proposal_voter` for every voter
+     * that voted for the proposal through `voteproposal`, so its votes can be removed without scanning all WPS
+     * voters. Rows are only written by `voteproposal`, stake changes leave them untouched. Votes cast before the
+     * index existed get their row from `fillpropvote`.
+     */
+    typedef eosio::multi_index< "propvoters"_n, wps_proposal_voter >  wps_proposal_voters_table;
+
    typedef eosio::multi_index< "producers"_n, producer_info,
                                indexed_by<"prototalvote"_n, const_mem_fun<producer_info, double, &producer_info::by_votes>  >
                              > producers_table;
@@ -492,17 +566,43 @@ namespace eosiosystem {
 
    typedef eosio::singleton< "global3"_n, eosio_global_state3 > global_state3_singleton;
 
+   typedef eosio::singleton< "global4"_n, eosio_global_state4 > global_state4_singleton;
+
+   static constexpr uint32_t ram_price_history_size    = 24;                      // samples kept in the ram price history
+   static constexpr uint32_t ram_price_sample_interval = seconds_per_hour;        // minimum time between two samples
+   static constexpr uint64_t ram_price_scale           = 1'000'000'000'000ull;    // ram prices are in core token units per byte times this
+
+   struct ram_price_sample {
+      time_point_sec time;
+      uint128_t      cumulative_price = 0; ///< sum of the ram price times the seconds it lasted, up to `time`
+
+      EOSLIB_SERIALIZE( ram_price_sample, (time)(cumulative_price) )
+   };
+
+   // Ram price history, accumulated before every change of the ram market and sampled into a ring buffer
+   // from which time-weighted average prices can be computed, see `system_contract::get_ram_twap`
+   struct [[eosio::table("ramprice"), eosio::contract("eosio.system")]] ram_price_history {
+      ram_price_sample              last;     ///< accumulated up to the last change of the ram market
+      std::vector<ram_price_sample> samples;  ///< ring buffer of past values of `last`
+      uint32_t                      head = 0; ///< index of the latest entry of `samples`
+
+      EOSLIB_SERIALIZE( ram_price_history, (last)(samples)(head) )
+   };
+
+   typedef eosio::singleton< "ramprice"_n, ram_price_history > ram_price_history_singleton;
+
    struct [[eosio::table, eosio::contract("eosio.system")]] user_resources {
       name          owner;
       asset         net_weight;
       asset         cpu_weight;
       int64_t       ram_bytes = 0;
+      eosio::binary_extension<uint32_t> flags1; ///< managed resources, see `voter_info::flags1_fields`; absent until migrated from `voter_info::flags1`
 
       bool is_empty()const { return net_weight.amount == 0 && cpu_weight.amount == 0 && ram_bytes == 0; }
       uint64_t primary_key()const { return owner.value; }
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
-      EOSLIB_SERIALIZE( user_resources, (owner)(net_weight)(cpu_weight)(ram_bytes) )
+      EOSLIB_SERIALIZE( user_resources, (owner)(net_weight)(cpu_weight)(ram_bytes)(flags1) )
    };
 
    // Every user 'from' has a scope/table that uses every recipient 'to' as the primary key.
@@ -520,6 +620,16 @@ namespace eosiosystem {
 
    };
 
+   // Reverse index of `delband`, scoped by the receiver: one row per account delegating to it. Delegations
+   // made before the index existed get their row from `filldelegs`.
+   struct [[eosio::table, eosio::contract("eosio.system")]] delegator_info {
+      name          from;
+
+      uint64_t  primary_key()const { return from.value; }
+
+      EOSLIB_SERIALIZE( delegator_info, (from) )
+   };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] refund_request {
       name            owner;
       time_point_sec  request_time;
@@ -533,6 +643,26 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( refund_request, (owner)(request_time)(net_amount)(cpu_amount) )
    };
 
+   // Owners who chose to have their refunds paid out by `processrefunds`, scoped by the system contract
+   struct [[eosio::table, eosio::contract("eosio.system")]] auto_refund {
+      name            owner;
+
+      uint64_t  primary_key()const { return owner.value; }
+
+      EOSLIB_SERIALIZE( auto_refund, (owner) )
+   };
+
+   // Refund requests of the `autorefunds` owners by maturity time, scoped by the system contract
+   struct [[eosio::table, eosio::contract("eosio.system")]] refund_queue_entry {
+      name            owner;
+      time_point_sec  matures; ///< request_time + refund_delay_sec of the refund request of owner
+
+      uint64_t  primary_key()const { return owner.value; }
+      uint64_t  by_maturity()const { return matures.sec_since_epoch(); }
+
+      EOSLIB_SERIALIZE( refund_queue_entry, (owner)(matures) )
+   };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] genesis_nonce {
       uint64_t       nonce;
       eosio::asset   awarded;
@@ -562,7 +692,12 @@ namespace eosiosystem {
     */
    typedef eosio::multi_index< "userres"_n, user_resources >      user_resources_table;
    typedef eosio::multi_index< "delband"_n, delegated_bandwidth > del_bandwidth_table;
+   typedef eosio::multi_index< "delegators"_n, delegator_info >   delegators_table;
    typedef eosio::multi_index< "refunds"_n, refund_request >      refunds_table;
+   typedef eosio::multi_index< "autorefunds"_n, auto_refund >      auto_refunds_table;
+   typedef eosio::multi_index< "refundqueue"_n, refund_queue_entry,
+                               indexed_by<"bymaturity"_n, const_mem_fun<refund_queue_entry, uint64_t, &refund_queue_entry::by_maturity>  >
+                             > refund_queue_table;
    typedef eosio::multi_index< "genesis"_n, genesis_tokens >      genesis_balance_table;
    typedef eosio::multi_index< "genonce"_n, genesis_nonce >       genesis_nonce_table;
 
@@ -651,6 +786,17 @@ namespace eosiosystem {
       time_point_sec utilization_timestamp   = {};                 // When adjusted_utilization was last updated
    };
 
+   // Weight changes of `eosio.reserv` that were not applied to its resources yet. Until they are, the reserve's limits,
+   // and so the total weight of the chain, are stale by at most 1/sync_div of each market for at most sync_secs.
+   struct powerup_reserve_sync {
+      static constexpr uint32_t sync_secs = 3600; // Apply the pending deltas at least this often
+      static constexpr int64_t  sync_div  = 1000; // Apply them as soon as one exceeds 1/sync_div of its market weight
+
+      int64_t        net_delta = 0;  // pending NET weight change
+      int64_t        cpu_delta = 0;  // pending CPU weight change
+      time_point_sec last_sync = {}; // when the pending deltas were last applied
+   };
+
    struct [[eosio::table("powup.state"),eosio::contract("eosio.system")]] powerup_state {
       static constexpr uint32_t default_powerup_days = 30; // 30 day resource powerup
 
@@ -659,6 +805,7 @@ namespace eosiosystem {
       powerup_state_resource     cpu               = {};                     // CPU market state
       uint32_t                   powerup_days      = default_powerup_days;   // `powerup` `days` argument must match this.
       asset                      min_powerup_fee   = {};                     // fees below this amount are rejected
+      eosio::binary_extension<powerup_reserve_sync> reserve_sync;          // pending `eosio.reserv` weight changes
 
       uint64_t primary_key()const { return 0; }
    };
@@ -683,6 +830,175 @@ namespace eosiosystem {
                                indexed_by<"byexpires"_n, const_mem_fun<powerup_order, uint64_t, &powerup_order::by_expires>>
                                > powerup_order_table;
 
+   // A day of the powerup expiry wheel. The orders expiring during `day` are stored in the `powup.queue` and
+   // `powup.merge` tables scoped by `day`, and the bucket counts the orders that are still there.
+   struct [[eosio::table("powup.bucket"),eosio::contract("eosio.system")]] powerup_bucket {
+      uint32_t             day;             // expiry day, in days since the epoch
+      uint32_t             orders     = 0;  // number of queued orders
+
+      uint64_t primary_key()const { return day; }
+   };
+
+   typedef eosio::multi_index< "powup.bucket"_n, powerup_bucket > powerup_bucket_table;
+
+   // A powerup order queued in the bucket of its expiry day, orders placed before the expiry wheel stay in `powup.order`
+   struct [[eosio::table("powup.queue"),eosio::contract("eosio.system")]] powerup_queued_order {
+      uint64_t             id;
+      name                 owner;
+      int64_t              net_weight;
+      int64_t              cpu_weight;
+      time_point_sec       expires;
+
+      uint64_t primary_key()const { return id; }
+      uint64_t by_expires()const  { return expires.utc_seconds; }
+   };
+
+   typedef eosio::multi_index< "powup.queue"_n, powerup_queued_order,
+                               indexed_by<"byexpires"_n, const_mem_fun<powerup_queued_order, uint64_t, &powerup_queued_order::by_expires>>
+                               > powerup_queue_table;
+
+   // A powerup order merged per receiver, scoped by its expiry day and expiring at the start of that day
+   struct [[eosio::table("powup.merge"),eosio::contract("eosio.system")]] powerup_merged_order {
+      name                 owner;
+      int64_t              net_weight;
+      int64_t              cpu_weight;
+
+      uint64_t primary_key()const { return owner.value; }
+   };
+
+   typedef eosio::multi_index< "powup.merge"_n, powerup_merged_order > powerup_merge_table;
+
+   // Total of the subscription balances escrowed in `eosio.reserv`, so the escrow can be told apart from the reserve
+   struct [[eosio::table("powup.escrow"),eosio::contract("eosio.system")]] powerup_escrow {
+      asset                balance;
+
+      uint64_t primary_key()const { return 0; }
+   };
+
+   typedef eosio::singleton<"powup.escrow"_n, powerup_escrow> powerup_escrow_singleton;
+
+   // A recurring powerup of `receiver`, renewed by `runsubs` and paid from the balance `owner` escrowed in `eosio.reserv`
+   struct [[eosio::table("powup.subs"),eosio::contract("eosio.system")]] powerup_subscription {
+      static constexpr uint32_t retry_secs = 3600; // Delay before retrying a renewal that could not be made
+      static constexpr uint32_t parked     = ~uint32_t(0); // `next_run` of a drained subscription
+
+      uint64_t             id;
+      name                 owner;     // funds the subscription and can cancel it
+      name                 receiver;
+      int64_t              net_frac;  // fraction of net (100% = 10^15) to reserve at each renewal
+      int64_t              cpu_frac;  // fraction of cpu (100% = 10^15) to reserve at each renewal
+      asset                max_fee;   // highest fee paid for one renewal
+      asset                balance;   // escrowed tokens left to pay the renewals
+      time_point_sec       next_run;  // when the next renewal is due
+
+      uint64_t  primary_key()const { return id; }
+      uint128_t by_owner()const { return owner_key(owner, receiver); }
+      uint64_t  by_next_run()const { return next_run.utc_seconds; }
+
+      static uint128_t owner_key(const name& owner, const name& receiver) {
+         return (uint128_t(owner.value) << 64) | receiver.value;
+      }
+   };
+
+   typedef eosio::multi_index< "powup.subs"_n, powerup_subscription,
+                               indexed_by<"byowner"_n, const_mem_fun<powerup_subscription, uint128_t, &powerup_subscription::by_owner>>,
+                               indexed_by<"bynextrun"_n, const_mem_fun<powerup_subscription, uint64_t, &powerup_subscription::by_next_run>>
+                               > powerup_subscription_table;
+
+   // Action return values, returned to the caller so that clients don't have to re-query tables afterwards
+
+   // Result of `buyram` and `buyrambytes`
+   struct action_return_buyram {
+      name     payer;
+      name     receiver;
+      asset    quantity;         ///< tokens spent, fee included
+      int64_t  bytes_purchased;
+      int64_t  ram_bytes;        ///< ram quota of `receiver` after the purchase
+      asset    fee;
+   };
+
+   // One entry of `buyrammany`
+   struct ram_purchase {
+      name     receiver;
+      uint32_t bytes;
+   };
+
+   // Result of `sellram`
+   struct action_return_sellram {
+      name     account;
+      asset    quantity;         ///< tokens received, before the fee is paid
+      int64_t  bytes_sold;
+      int64_t  ram_bytes;        ///< ram quota of `account` after the sale
+      asset    fee;
+   };
+
+   // Result of `refund`
+   struct action_return_refund {
+      name     owner;
+      asset    net_amount;
+      asset    cpu_amount;
+   };
+
+   // Result of `claimrewards` and `claimgbmprod`
+   struct action_return_claimrewards {
+      name     owner;
+      asset    block_pay;
+   };
+
+   // Result of `voterclaim` and `claimgbmvote`
+   struct action_return_voterclaim {
+      name     owner;
+      asset    voter_pay;
+   };
+
+   // Resource limits of an account, as passed to `set_resource_limits`
+   struct account_limits {
+      int64_t ram_bytes  = 0;
+      int64_t net_weight = 0;
+      int64_t cpu_weight = 0;
+
+      friend bool operator==( const account_limits& a, const account_limits& b ) {
+         return a.ram_bytes == b.ram_bytes && a.net_weight == b.net_weight && a.cpu_weight == b.cpu_weight;
+      }
+   };
+
+   // One entry of `delegatebwmany` and `undelegatebwmany`
+   struct bw_delegation {
+      name     receiver;
+      asset    net;
+      asset    cpu;
+   };
+
+   // Result of `ramtransfer`
+   struct action_return_ramtransfer {
+      name     from;
+      name     to;
+      int64_t  bytes;
+      int64_t  from_ram_bytes;   ///< ram quota of `from` after the transfer
+      int64_t  to_ram_bytes;     ///< ram quota of `to` after the transfer
+   };
+
+   // Result of `quoteram`
+   struct action_return_quoteram {
+      asset    quantity;         ///< tokens to spend, fee included
+      int64_t  bytes;            ///< bytes `buyram` would purchase for `quantity`
+      asset    fee;
+   };
+
+   // Result of `powerup` and `quotepowerup`, same data as the `powupresult` inline action
+   struct action_return_powerup {
+      asset    fee;
+      int64_t  powup_net_weight;
+      int64_t  powup_cpu_weight;
+   };
+
+   // One entry of `powerupmany`
+   struct powerup_request {
+      name     receiver;
+      int64_t  net_frac;
+      int64_t  cpu_frac;
+   };
+
    /**
     * The `eosio.system` smart contract is provided by `block.one` as a sample system contract, and it defines the structures and actions needed for blockchain's core functionality.
     *
@@ -707,16 +1023,21 @@ namespace eosiosystem {
          global_state_singleton  _global;
          global_state2_singleton _global2;
          global_state3_singleton _global3;
+         global_state4_singleton _global4;
          eosio_global_state      _gstate;
          eosio_global_state2     _gstate2;
          eosio_global_state3     _gstate3;
+         eosio_global_state4     _gstate4;
          rammarket               _rammarket;
          proposer_table          _proposers;
          proposal_table          _proposals;
+         proposal_tally_table    _proptally;
          committee_table          _committees;
          reviewer_table          _reviewers;
          wps_global_state_singleton _wps_global;
          wps_global_state        _wps_state;
+         // per account: limits set on chain, and limits to set on chain when the action ends
+         std::map<name, std::pair<account_limits, account_limits>> _account_limits;
 
       public:
          static constexpr eosio::name active_permission{"active"_n};
@@ -747,6 +1068,43 @@ namespace eosiosystem {
             return sym;
          }
 
+          // Returns the ram price of a ram market, in core token units per byte times `ram_price_scale`
+          // @param market - the ram market.
+         static uint128_t get_ram_price( const exchange_state& market ) {
+            if( market.base.balance.amount <= 0 ) return 0;
+            return uint128_t(market.quote.balance.amount) * ram_price_scale / market.base.balance.amount;
+         }
+
+          // Returns the time-weighted average ram price of the last `window` seconds, in core token units
+          // per byte times `ram_price_scale`. The average starts at the newest sample at least `window`
+          // seconds old, so it may cover up to `ram_price_sample_interval` more than asked.
+          // @param window - the length of the average in seconds,
+          // @param system_account - the system account to get the ram price history for.
+         static uint128_t get_ram_twap( uint32_t window, name system_account = "eosio"_n ) {
+            check( window > 0, "window must be positive" );
+            ram_price_history_singleton hist_sing( system_account, system_account.value );
+            check( hist_sing.exists(), "ram price history is empty" );
+            const auto hist = hist_sing.get();
+
+            rammarket rm( system_account, system_account.value );
+            const auto& market = rm.get( ramcore_symbol.raw(), "system contract must first be initialized" );
+
+            const uint32_t now = eosio::current_time_point().sec_since_epoch();
+            const uint128_t cumulative = hist.last.cumulative_price
+                                       + get_ram_price( market ) * ( now - hist.last.time.sec_since_epoch() );
+
+            const uint32_t size = hist.samples.size();
+            for( uint32_t i = 0; i < size; ++i ) {
+               const auto& sample = hist.samples[ (hist.head + size - i) % size ];
+               const uint32_t age = now - sample.time.sec_since_epoch();
+               if( age >= window ) {
+                  return ( cumulative - sample.cumulative_price ) / age;
+               }
+            }
+            check( false, "not enough ram price history for this window" );
+            return 0;
+         }
+
          // Actions:
          /**
           * The Init action initializes the system contract for a version and a symbol.
@@ -785,6 +1143,15 @@ namespace eosiosystem {
          [[eosio::action]]
          void setalimits( const name& account, int64_t ram_bytes, int64_t net_weight, int64_t cpu_weight );
 
+         /**
+          * Migrate flags action, copies the managed-resource flags of `accounts` from their voter rows to their
+          * resource rows, which is otherwise done the next time their resources change.
+          *
+          * @param accounts - the accounts to migrate.
+          */
+         [[eosio::action]]
+         void migrateflags( const std::vector<name>& accounts );
+
          /**
           * Set account RAM limits action, which sets the RAM limits of an account
           *
@@ -871,6 +1238,56 @@ namespace eosiosystem {
          void undelegatebw( const name& from, const name& receiver,
                             const asset& unstake_net_quantity, const asset& unstake_cpu_quantity );
 
+         /**
+          * Delegate bandwidth to many receivers action, behaves like one `delegatebw` per entry of
+          * `delegations` without `transfer`, except that `from` sends a single stake transfer and its
+          * voting power is updated once for the whole batch.
+          *
+          * @param from - the account to delegate bandwidth from,
+          * @param delegations - the receivers and the tokens staked for each of them.
+          */
+         [[eosio::action]]
+         void delegatebwmany( const name& from, const std::vector<bw_delegation>& delegations );
+
+         /**
+          * Undelegate bandwidth from many receivers action, behaves like one `undelegatebw` per entry of
+          * `delegations`, except that the refund request of `from` and its voting power are updated once for
+          * the whole batch.
+          *
+          * @param from - the account to undelegate bandwidth from,
+          * @param delegations - the receivers and the tokens unstaked from each of them.
+          */
+         [[eosio::action]]
+         void undelegatebwmany( const name& from, const std::vector<bw_delegation>& delegations );
+
+         /**
+          * Undelegate all bandwidth action, undelegates everything `from` has delegated to up to `max`
+          * receivers, starting at receiver `cursor`, as a single `undelegatebwmany`.
+          *
+          * @param from - the account to undelegate bandwidth from,
+          * @param cursor - the first receiver to undelegate from, empty to start from the beginning,
+          * @param max - the maximum number of receivers to undelegate from.
+          *
+          * @return the receiver to pass as `cursor` to continue, empty when there is nothing left.
+          */
+         [[eosio::action]]
+         name undelegateall( const name& from, const name& cursor, uint16_t max );
+
+         /**
+          * Fill delegators action, adds the missing `delegators` rows of up to `max` delegations of `from`,
+          * starting at receiver `cursor`. Delegations made before the `delegators` index existed have no row
+          * until this action, or a full undelegation, reaches them. Anyone can call it, the rows are paid by
+          * the system contract.
+          *
+          * @param from - the account whose delegations are indexed,
+          * @param cursor - the first receiver to index, empty to start from the beginning,
+          * @param max - the maximum number of delegations to visit.
+          *
+          * @return the receiver to pass as `cursor` to continue, empty when there is nothing left.
+          */
+         [[eosio::action]]
+         name filldelegs( const name& from, const name& cursor, uint16_t max );
+
          /**
           * Removing the amount of tokens from account's refunds
           */
@@ -883,6 +1300,31 @@ namespace eosiosystem {
          [[eosio::action]]
          void claimgenesis( name claimer);
 
+         /**
+          * Purge genesis action, settles and erases up to `max` expired GBM awards.
+          *
+          * @details GBM ended at `gbm_final_time`. For every `genonce` row processed, the remaining unclaimed
+          * genesis balance of its receiver is paid out from `genesis.wax` and both the `genesis` and `genonce`
+          * rows are erased to reclaim RAM. The first call marks genesis as retired, after which `undelegatebw`
+          * no longer touches genesis state. Genesis rows without a `genonce` row are settled by `purgegenacct`.
+          *
+          * @param max - maximum number of `genonce` rows to process.
+          */
+         [[eosio::action]]
+         void purgegenesis( uint32_t max );
+
+         /**
+          * Purge genesis accounts action, settles and erases the expired GBM awards of `receivers`.
+          *
+          * @details Same as `purgegenesis` for `genesis` rows that have no `genonce` row, which `purgegenesis`
+          * never visits. Receivers without a `genesis` row are skipped. Genesis rows are scoped by receiver, so
+          * they are listed off chain.
+          *
+          * @param receivers - the accounts whose genesis rows are settled.
+          */
+         [[eosio::action]]
+         void purgegenacct( const std::vector<name>& receivers );
+
          /**
           * Buy ram action, increases receiver's ram quota based upon current price and quantity of
           * tokens provided. An inline transfer from receiver to system contract of
@@ -891,9 +1333,11 @@ namespace eosiosystem {
           * @param payer - the ram buyer,
           * @param receiver - the ram receiver,
           * @param quant - the quantity of tokens to buy ram with.
+          *
+          * @return the tokens spent, the bytes purchased, the resulting ram quota of receiver and the fee.
           */
          [[eosio::action]]
-         void buyram( const name& payer, const name& receiver, const asset& quant );
+         action_return_buyram buyram( const name& payer, const name& receiver, const asset& quant );
 
          /**
           * Buy a specific amount of ram bytes action. Increases receiver's ram in quantity of bytes provided.
@@ -902,9 +1346,24 @@ namespace eosiosystem {
           * @param payer - the ram buyer,
           * @param receiver - the ram receiver,
           * @param bytes - the quantity of ram to buy specified in bytes.
+          *
+          * @return the tokens spent, the bytes purchased, the resulting ram quota of receiver and the fee.
           */
          [[eosio::action]]
-         void buyrambytes( const name& payer, const name& receiver, uint32_t bytes );
+         action_return_buyram buyrambytes( const name& payer, const name& receiver, uint32_t bytes );
+
+         /**
+          * Buy ram for many receivers action, behaves like one `buyrambytes` per entry of `purchases`,
+          * priced one after the other, except that the payer sends a single transfer for the ram of the
+          * whole batch and a single transfer for its fees.
+          *
+          * @param payer - the ram buyer,
+          * @param purchases - the receivers and the bytes to buy for each of them.
+          *
+          * @return the result of each purchase, as `buyrambytes` would return it.
+          */
+         [[eosio::action]]
+         std::vector<action_return_buyram> buyrammany( const name& payer, const std::vector<ram_purchase>& purchases );
 
          /**
           * Sell ram action, reduces quota by bytes and then performs an inline transfer of tokens
@@ -912,18 +1371,79 @@ namespace eosiosystem {
           *
           * @param account - the ram seller account,
           * @param bytes - the amount of ram to sell in bytes.
+          *
+          * @return the tokens received, the bytes sold, the resulting ram quota of account and the fee.
           */
          [[eosio::action]]
-         void sellram( const name& account, int64_t bytes );
+         action_return_sellram sellram( const name& account, int64_t bytes );
+
+         /**
+          * Transfer ram action, moves ram quota from `from` to `to` without going through the ram market.
+          * No tokens are exchanged and no fee is charged.
+          *
+          * @param from - the account giving ram,
+          * @param to - the account receiving ram,
+          * @param bytes - the amount of ram to transfer in bytes.
+          *
+          * @return the bytes transferred and the resulting ram quotas of both accounts.
+          */
+         [[eosio::action]]
+         action_return_ramtransfer ramtransfer( const name& from, const name& to, int64_t bytes );
+
+         /**
+          * Quote ram action, prices a ram purchase with the exact math of `buyram` and `buyrambytes` against the
+          * current ram market, including the ram supply added since the last trade. It does not modify any
+          * state and is meant to be executed without being committed, e.g. through `compute_transaction`.
+          *
+          * @param bytes - if specified, quotes `buyrambytes` for this amount of bytes,
+          * @param quant - if specified, quotes `buyram` for this quantity of tokens.
+          *
+          * @pre Exactly one of `bytes` and `quant` is specified.
+          * @return the tokens to spend, the bytes purchased and the fee.
+          */
+         [[eosio::action]]
+         action_return_quoteram quoteram( const std::optional<uint32_t>& bytes, const std::optional<asset>& quant );
 
          /**
           * Refund action, this action is called after the delegation-period to claim all pending
           * unstaked tokens belonging to owner.
           *
           * @param owner - the owner of the tokens claimed.
+          *
+          * @return the refunded net and cpu amounts.
+          */
+         [[eosio::action]]
+         action_return_refund refund( const name& owner );
+
+         /**
+          * Process refunds action, pays out up to `max` refund requests whose delegation-period is over,
+          * oldest first, and frees their rows. Anyone can call it. Only the refunds of owners who enabled
+          * `autorefund` are paid, the others are claimed with `refund`.
+          *
+          * @param max - the maximum number of refund requests to pay out.
+          */
+         [[eosio::action]]
+         void processrefunds( uint16_t max );
+
+         /**
+          * Auto refund action, lets `owner` choose whether `processrefunds` pays out its refunds. Each payout
+          * notifies `owner`, and a payout its contract rejects would stop `processrefunds`, so the queue only
+          * holds owners who asked for it. Enabling it also queues a refund request made before.
+          *
+          * @param owner - the owner of the refunds,
+          * @param enabled - true to have refunds paid out by `processrefunds`, false to claim them with `refund`.
           */
          [[eosio::action]]
-         void refund( const name& owner );
+         void autorefund( const name& owner, bool enabled );
+
+         /**
+          * Park refund action, takes the due refund of `owner` out of the `processrefunds` queue, for a payout
+          * that `owner` rejects. The refund stays claimable with `refund`. Anyone can call it.
+          *
+          * @param owner - the owner of the refund.
+          */
+         [[eosio::action]]
+         void parkrefund( const name& owner );
 
          // functions defined in voting.cpp
 
@@ -1040,9 +1560,10 @@ namespace eosiosystem {
           *
           * @details Claim the rewards for a voter.
           * @param owner - voter account claiming its rewards.
+          * @return the voter pay transferred to owner.
           */
          [[eosio::action]]
-         void voterclaim(const name owner);
+         action_return_voterclaim voterclaim(const name owner);
 
          // functions defined in producer_pay.cpp
 
@@ -1059,18 +1580,20 @@ namespace eosiosystem {
          /**
           * Claim rewards action, claims block producing and vote rewards.
           * @param owner - producer account claiming per-block and per-vote rewards.
+          * @return the block pay transferred to owner.
           */
          [[eosio::action]]
-         void claimrewards( const name& owner );
+         action_return_claimrewards claimrewards( const name& owner );
 
          /**
           * Claim GBM vote reward.
           *
           * @details Claims the GBM reward for a voter.
           * @param owner - voter account claiming the reward.
+          * @return the voter pay transferred to owner.
          */
          [[eosio::action]]
-         void claimgbmvote(const name owner);
+         action_return_voterclaim claimgbmvote(const name owner);
 
 
          /**
@@ -1078,9 +1601,10 @@ namespace eosiosystem {
           *
           * @details Claims the GBM reward for a producer.
           * @param owner - producer account claiming the reward.
+          * @return the block pay transferred to owner.
          */
          [[eosio::action]]
-         void claimgbmprod( const name owner );
+         action_return_claimrewards claimgbmprod( const name owner );
 
          /**
           * Set privilege status for an account. Allows to set privilege status for an account (turn it on/off).
@@ -1135,6 +1659,38 @@ namespace eosiosystem {
          [[eosio::action]]
          void bidrefund( const name& bidder, const name& newname );
 
+         /**
+          * Bid refunds action, allows the account `bidder` to get back the amounts it bid so far on up to `max`
+          * names, in a single transfer.
+          *
+          * @param bidder - the account that gets refunded,
+          * @param max - the maximum number of names to get refunded for.
+          */
+         [[eosio::action]]
+         void bidrefunds( const name& bidder, uint16_t max );
+
+         /**
+          * Prune bids action, removes up to `max` closed auctions whose winner did not claim the name within
+          * the grace period set by `cfgbidprune`, counted from the close, and refunds their winning bids.
+          * The refunds are claimed with `bidrefund` or `bidrefunds`. Anyone can call it.
+          *
+          * @param cursor - the name to start from, the empty name starts from the first bid,
+          * @param max - the maximum number of bids to visit.
+          *
+          * @return the name to pass as `cursor` to continue, the empty name when all bids were visited.
+          */
+         [[eosio::action]]
+         name prunebids( const name& cursor, uint16_t max );
+
+         /**
+          * Configure bid pruning action, sets how long the winner of a closed auction has to claim the name
+          * before `prunebids` can remove its bid.
+          *
+          * @param grace_sec - the grace period in seconds, counted from the close, at least 7 days, 0 disables `prunebids`.
+          */
+         [[eosio::action]]
+         void cfgbidprune( uint32_t grace_sec );
+
          [[eosio::action]]
          void regproposer(name account, const string& first_name, const string& last_name,
                             const string& img_url, const string& bio, const string& country, const string& telegram,
@@ -1201,14 +1757,56 @@ namespace eosiosystem {
          [[eosio::action]]
          void approve(name reviewer, name proposer);
 
+         /**
+          * Remove rejected proposal action, removes the votes of up to `wps_votes_removed_per_action` voters
+          * for the rejected proposal of `proposer`, then the proposal once no votes are left.
+          *
+          * @param reviewer - a reviewer of the proposal's committee,
+          * @param proposer - the proposer of the proposal.
+          *
+          * @return true when the proposal was removed, false when votes are left and the action must be repeated.
+          */
+         [[eosio::action]]
+         bool rmvreject(name reviewer, name proposer);
+
+         /**
+          * Remove completed proposal action, same as `rmvreject` for a completed proposal.
+          *
+          * @param reviewer - a reviewer of the proposal's committee,
+          * @param proposer - the proposer of the proposal.
+          *
+          * @return true when the proposal was removed, false when votes are left and the action must be repeated.
+          */
          [[eosio::action]]
-         void rmvreject(name reviewer, name proposer);
+         bool rmvcompleted(name reviewer, name proposer);
 
+         /**
+          * Clean votes action, removes the votes for the proposal of `proposer` from up to `max` WPS voters,
+          * starting at voter `cursor`.
+          *
+          * @param reviewer - the reviewer cleaning the votes,
+          * @param proposer - the proposer of the proposal whose votes are removed,
+          * @param cursor - the first voter to visit, empty to start from the beginning,
+          * @param max - the maximum number of voters to visit.
+          *
+          * @return the voter to pass as `cursor` to continue, empty when all voters were visited.
+          */
          [[eosio::action]]
-         void rmvcompleted(name reviewer, name proposer);
+         name cleanvotes(name reviewer, name proposer, name cursor, uint16_t max);
 
+         /**
+          * Fill proposal voters action, adds the missing `propvoters` rows of up to `max` WPS voters, starting
+          * at voter `cursor`. Votes cast before the `propvoters` index existed have no row until this action,
+          * or a new vote of the voter, reaches them, and `rmvreject` and `rmvcompleted` leave them behind.
+          * Anyone can call it, the rows are paid by the system contract.
+          *
+          * @param cursor - the first voter to index, empty to start from the beginning,
+          * @param max - the maximum number of voters to visit.
+          *
+          * @return the voter to pass as `cursor` to continue, empty when all voters were visited.
+          */
          [[eosio::action]]
-         void cleanvotes(name reviewer, name proposer, uint64_t begin, uint64_t end);
+         name fillpropvote(const name& cursor, uint16_t max);
 
          [[eosio::action]]
          void setwpsenv(uint32_t total_voting_percent, uint32_t duration_of_voting, uint32_t max_duration_of_funding, uint32_t total_iteration_of_funding);
@@ -1257,9 +1855,98 @@ namespace eosiosystem {
           * @param cpu_frac - fraction of cpu (100% = 10^15) managed by this market
           * @param max_payment - the maximum amount `payer` is willing to pay. Tokens are withdrawn from
           *    `payer`'s token balance.
+          *
+          * @return the fee paid and the NET and CPU weights received.
+          */
+         [[eosio::action]]
+         action_return_powerup powerup( const name& payer, const name& receiver, uint32_t days, int64_t net_frac, int64_t cpu_frac, const asset& max_payment );
+
+         /**
+          * Powerup for many receivers action, behaves like one `powerup` per entry of `requests` for the configured
+          * number of days, priced one after the other, except that the payer sends a single transfer for the fees of
+          * the whole batch and no `powupresult` inline action is sent.
+          *
+          * @param payer - the resource buyer
+          * @param requests - the receivers and the fractions of net and cpu (100% = 10^15) to reserve for each of them
+          * @param max_payment - the maximum amount `payer` is willing to pay for the whole batch
+          *
+          * @return the result of each powerup, as `powerup` would return it.
+          */
+         [[eosio::action]]
+         std::vector<action_return_powerup> powerupmany( const name& payer, const std::vector<powerup_request>& requests,
+                                                        const asset& max_payment );
+
+         /**
+          * Subscribe powerup action, creates or updates the recurring powerup `owner` funds for `receiver`, each
+          * owner having its own subscription per receiver. A new subscription is renewed by the next `runsubs`,
+          * then every time its powerup expires, as long as its fee does not exceed `max_fee` and the escrowed
+          * balance covers it.
+          *
+          * @param owner - the account funding the subscription, the only one that can update or cancel it
+          * @param receiver - the resource receiver
+          * @param net_frac - fraction of net (100% = 10^15) to reserve at each renewal
+          * @param cpu_frac - fraction of cpu (100% = 10^15) to reserve at each renewal
+          * @param max_fee - the maximum fee `owner` is willing to pay for one renewal, at least `min_powerup_fee`
+          * @param deposit - tokens transferred from `owner` and added to the escrowed balance, may be zero
+          */
+         [[eosio::action]]
+         void subpowerup( const name& owner, const name& receiver, int64_t net_frac, int64_t cpu_frac,
+                          const asset& max_fee, const asset& deposit );
+
+         /**
+          * Unsubscribe powerup action, cancels the recurring powerup `owner` funds for `receiver` and returns the
+          * escrowed balance to `owner`. Resources from past renewals are kept until they expire.
+          *
+          * @param owner - the account funding the subscription
+          * @param receiver - the resource receiver
+          */
+         [[eosio::action]]
+         void unsubpowerup( const name& owner, const name& receiver );
+
+         /**
+          * Run subscriptions action, renews up to `max` due subscriptions against the current market and pays
+          * their fees with a single transfer. A renewal that can't be made, because the market lacks resources,
+          * the fee exceeds its `max_fee` or its balance, is retried an hour later. A subscription whose balance
+          * is below `min_powerup_fee` is parked instead: it is no longer renewed until `subpowerup` tops it up,
+          * and its owner gets the balance back with `unsubpowerup`. Anyone can call it.
+          *
+          * @param max - the maximum number of due subscriptions to process
+          */
+         [[eosio::action]]
+         void runsubs( uint16_t max );
+
+         /**
+          * Enables or disables the `powupresult` inline action sent to `eosio.reserv` by `powerup`.
+          * The same data is always available as the return value of `powerup`.
+          *
+          * @param enabled - whether `powerup` sends the `powupresult` inline action.
+          */
+         [[eosio::action]]
+         void cfgpowupres( bool enabled );
+
+         /**
+          * Enables or disables merging of powerup orders. When enabled, the expiry of a `powerup` is rounded up to
+          * the next day boundary and the order is merged into the order of the same receiver expiring at that
+          * time, if any.
+          *
+          * @param enabled - whether `powerup` merges orders per receiver and expiry day.
+          */
+         [[eosio::action]]
+         void cfgpowupmrg( bool enabled );
+
+         /**
+          * Quote powerup action, prices a `powerup` of the given fractions with the exact math of `powerup`
+          * against the current market, including the expired orders `powerup` would retire first. It does
+          * not modify any state and is meant to be executed without being committed, e.g. through
+          * `compute_transaction`.
+          *
+          * @param net_frac - fraction of net (100% = 10^15) managed by this market
+          * @param cpu_frac - fraction of cpu (100% = 10^15) managed by this market
+          *
+          * @return the fee and the NET and CPU weights `powerup` would currently give.
           */
          [[eosio::action]]
-         void powerup( const name& payer, const name& receiver, uint32_t days, int64_t net_frac, int64_t cpu_frac, const asset& max_payment );
+         action_return_powerup quotepowerup( int64_t net_frac, int64_t cpu_frac );
 
        /**
         * limitauthchg opts into or out of restrictions on updateauth, deleteauth, linkauth, and unlinkauth.
@@ -1280,6 +1967,7 @@ namespace eosiosystem {
        void limitauthchg( const name& account, const std::vector<name>& allow_perms, const std::vector<name>& disallow_perms );
 
          using init_action = eosio::action_wrapper<"init"_n, &system_contract::init>;
+         using migrateflags_action = eosio::action_wrapper<"migrateflags"_n, &system_contract::migrateflags>;
          using setacctram_action = eosio::action_wrapper<"setacctram"_n, &system_contract::setacctram>;
          using setacctnet_action = eosio::action_wrapper<"setacctnet"_n, &system_contract::setacctnet>;
          using setacctcpu_action = eosio::action_wrapper<"setacctcpu"_n, &system_contract::setacctcpu>;
@@ -1287,11 +1975,23 @@ namespace eosiosystem {
          using delegatebw_action = eosio::action_wrapper<"delegatebw"_n, &system_contract::delegatebw>;
          using removerefund_action = eosio::action_wrapper<"removerefund"_n, &system_contract::removerefund>;
          using claimgenesis_action = eosio::action_wrapper<"claimgenesis"_n, &system_contract::claimgenesis>;
+         using purgegenesis_action = eosio::action_wrapper<"purgegenesis"_n, &system_contract::purgegenesis>;
+         using purgegenacct_action = eosio::action_wrapper<"purgegenacct"_n, &system_contract::purgegenacct>;
          using undelegatebw_action = eosio::action_wrapper<"undelegatebw"_n, &system_contract::undelegatebw>;
+         using delegatebwmany_action = eosio::action_wrapper<"delegatebwmany"_n, &system_contract::delegatebwmany>;
+         using undelegatebwmany_action = eosio::action_wrapper<"undelegatebwmany"_n, &system_contract::undelegatebwmany>;
+         using undelegateall_action = eosio::action_wrapper<"undelegateall"_n, &system_contract::undelegateall>;
+         using filldelegs_action = eosio::action_wrapper<"filldelegs"_n, &system_contract::filldelegs>;
          using buyram_action = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
+         using buyrammany_action = eosio::action_wrapper<"buyrammany"_n, &system_contract::buyrammany>;
          using sellram_action = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
+         using ramtransfer_action = eosio::action_wrapper<"ramtransfer"_n, &system_contract::ramtransfer>;
+         using quoteram_action = eosio::action_wrapper<"quoteram"_n, &system_contract::quoteram>;
          using refund_action = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
+         using processrefunds_action = eosio::action_wrapper<"processrefunds"_n, &system_contract::processrefunds>;
+         using autorefund_action = eosio::action_wrapper<"autorefund"_n, &system_contract::autorefund>;
+         using parkrefund_action = eosio::action_wrapper<"parkrefund"_n, &system_contract::parkrefund>;
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
          using regproducer2_action = eosio::action_wrapper<"regproducer2"_n, &system_contract::regproducer2>;
          using unregprod_action = eosio::action_wrapper<"unregprod"_n, &system_contract::unregprod>;
@@ -1304,6 +2004,9 @@ namespace eosiosystem {
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
+         using bidrefunds_action = eosio::action_wrapper<"bidrefunds"_n, &system_contract::bidrefunds>;
+         using prunebids_action = eosio::action_wrapper<"prunebids"_n, &system_contract::prunebids>;
+         using cfgbidprune_action = eosio::action_wrapper<"cfgbidprune"_n, &system_contract::cfgbidprune>;
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
@@ -1325,6 +2028,7 @@ namespace eosiosystem {
        using rmvreject_action = eosio::action_wrapper<"rmvreject"_n, &system_contract::rmvreject>;
        using rmvcompleted_action = eosio::action_wrapper<"rmvcompleted"_n, &system_contract::rmvcompleted>;
        using cleanvotes_action = eosio::action_wrapper<"cleanvotes"_n, &system_contract::cleanvotes>;
+       using fillpropvote_action = eosio::action_wrapper<"fillpropvote"_n, &system_contract::fillpropvote>;
        using setwpsenv_action = eosio::action_wrapper<"setwpsenv"_n, &system_contract::setwpsenv>;
        using setwpsstate_action = eosio::action_wrapper<"setwpsstate"_n, &system_contract::setwpsstate>;
        using rejectfund_action = eosio::action_wrapper<"rejectfund"_n, &system_contract::rejectfund>;
@@ -1332,11 +2036,18 @@ namespace eosiosystem {
        using cfgpowerup_action = eosio::action_wrapper<"cfgpowerup"_n, &system_contract::cfgpowerup>;
        using powerupexec_action = eosio::action_wrapper<"powerupexec"_n, &system_contract::powerupexec>;
        using powerup_action = eosio::action_wrapper<"powerup"_n, &system_contract::powerup>;
+       using powerupmany_action = eosio::action_wrapper<"powerupmany"_n, &system_contract::powerupmany>;
+       using subpowerup_action = eosio::action_wrapper<"subpowerup"_n, &system_contract::subpowerup>;
+       using unsubpowerup_action = eosio::action_wrapper<"unsubpowerup"_n, &system_contract::unsubpowerup>;
+       using runsubs_action = eosio::action_wrapper<"runsubs"_n, &system_contract::runsubs>;
+       using cfgpowupres_action = eosio::action_wrapper<"cfgpowupres"_n, &system_contract::cfgpowupres>;
+       using cfgpowupmrg_action = eosio::action_wrapper<"cfgpowupmrg"_n, &system_contract::cfgpowupmrg>;
+       using quotepowerup_action = eosio::action_wrapper<"quotepowerup"_n, &system_contract::quotepowerup>;
 
       private:
          // WAX specifics
 
-         void claim_producer_rewards( const name owner, bool as_gbm );
+         int64_t claim_producer_rewards( const name owner, bool as_gbm );
          int64_t get_unclaimed_gbm_balance( name claimer );
          int64_t collect_voter_reward(const name owner);
          void fill_buckets();
@@ -1352,16 +2063,41 @@ namespace eosiosystem {
          //defined in eosio.system.cpp
          static eosio_global_state get_default_parameters();
          symbol core_symbol()const;
+         uint64_t get_pending_ram_supply()const;
          void update_ram_supply();
+         void update_ram_price_history();
+         void get_account_limits( const name& account, int64_t& ram_bytes, int64_t& net_weight, int64_t& cpu_weight );
+         void set_account_limits( const name& account, int64_t ram_bytes, int64_t net_weight, int64_t cpu_weight );
+         void flush_account_limits();
+         uint32_t get_resource_flags( const name& account, const user_resources* res )const;
+         void set_resource_flags( const name& account );
+
+         // defined in name_bidding.cpp
+         void add_bid_refund( const name& payer, const name& bidder, const name& newname, const asset& amount );
+         void update_name_candidate( const name& newname, int64_t high_bid, time_point last_bid_time );
+         void refresh_name_candidate();
 
          //defined in wps.cpp
          void update_wps_votes( const name& voter, const std::vector<name>& proposals);
+         void update_proposal_voters( const name& voter, const std::vector<name>& old_proposals,
+                                      const std::vector<name>& proposals );
+         bool remove_proposal_votes( const name& proposer, uint32_t max );
+         proposal_tally_table::const_iterator get_proposal_tally( const proposal& prop );
+         void mirror_proposal_tally( proposal_table::const_iterator itr_proposal, const proposal_tally& tally );
 
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
                         const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
+         void update_delegation( const name& from, const name& receiver,
+                                 const asset& stake_net_delta, const asset& stake_cpu_delta );
+         asset update_refund( const name& owner, asset net_balance, asset cpu_balance );
+         int64_t add_ram( const name& receiver, int64_t bytes );
+         void undelegate_many( const name& from, const std::vector<bw_delegation>& delegations );
+         void queue_refund( const refund_request& req );
+         void dequeue_refund( const name& owner );
          void change_genesis( name unstaker );
          bool has_genesis_balance( name owner );
+         void settle_genesis( const name& receiver );
          void update_voting_power( const name& voter, const asset& total_update );
 
          // defined in voting.cpp
@@ -1414,7 +2150,11 @@ namespace eosiosystem {
          void process_powerup_queue(
             time_point_sec now, symbol core_symbol, powerup_state& state,
             powerup_order_table& orders, uint32_t max_items, int64_t& net_delta_available,
-            int64_t& cpu_delta_available);
+            int64_t& cpu_delta_available, bool dry_run = false);
+         void adjust_reserve(powerup_state& state, time_point_sec now, symbol core_symbol, int64_t net_delta,
+                             int64_t cpu_delta, bool sync);
+         time_point_sec queue_powerup_order(name payer, name owner, int64_t net_weight, int64_t cpu_weight, time_point_sec expires);
+         void add_powerup_escrow(const asset& delta);
    };
 
    double stake2vote( int64_t staked );
@@ -34,6 +34,7 @@ namespace eosiosystem {
       asset convert( const asset& from, const symbol& to );
       asset direct_convert( const asset& from, const symbol& to );
 
+      // Constant product conversions used by `direct_convert`, computed exactly with 128-bit integers
       static int64_t get_bancor_output( int64_t inp_reserve,
                                         int64_t out_reserve,
                                         int64_t inp );
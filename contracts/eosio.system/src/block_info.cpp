@@ -22,25 +22,48 @@ void system_contract::add_to_blockinfo_table(const eosio::checksum256&    previo
 
    block_info::block_info_table t(get_self(), 0);
 
-   if (block_info::rolling_window_size > 0) {
-      // Add new entry to blockinfo table for the new block.
+   // Overwrite the slot of the block that just fell out of the rolling window in place.
+   auto itr = t.find(block_info::block_info_record::slot_of(new_block_height));
+   if (itr != t.end()) {
+      t.modify(itr, same_payer, [&](block_info::block_info_record& r) {
+         r.block_height    = new_block_height;
+         r.block_timestamp = new_block_timestamp;
+      });
+   } else {
       t.emplace(get_self(), [&](block_info::block_info_record& r) {
+         r.version         = block_info::slot_record_version;
          r.block_height    = new_block_height;
          r.block_timestamp = new_block_timestamp;
       });
+
+      // Slots are only missing while the window is first filled. Erase the height keyed records left by an older
+      // system contract, there are at most a few more than the window size of them.
+      for (auto old = t.lower_bound(block_info::rolling_window_size); old != t.end();) {
+         old = t.erase(old);
+      }
    }
 
-   // Erase up to two entries that have fallen out of the rolling window.
+   // Record the new block in the summary of every batch size it starts a batch of.
+   for (uint32_t batch_size : block_info::summary_batch_sizes) {
+      if (new_block_height % batch_size != 0) {
+         continue;
+      }
 
-   const uint32_t last_prunable_block_height =
-      std::max(new_block_height, block_info::rolling_window_size) - block_info::rolling_window_size;
+      block_info::block_summary_table summaries(get_self(), batch_size);
 
-   int count = 2;
-   for (auto itr = t.begin(), end = t.end();                                        //
-        itr != end && itr->block_height <= last_prunable_block_height && 0 < count; //
-        --count)                                                                    //
-   {
-      itr = t.erase(itr);
+      auto summary_itr = summaries.find(block_info::block_summary_record::slot_of(new_block_height, batch_size));
+      if (summary_itr != summaries.end()) {
+         summaries.modify(summary_itr, same_payer, [&](block_info::block_summary_record& r) {
+            r.block_height    = new_block_height;
+            r.block_timestamp = new_block_timestamp;
+         });
+      } else {
+         summaries.emplace(get_self(), [&](block_info::block_summary_record& r) {
+            r.batch_size      = batch_size;
+            r.block_height    = new_block_height;
+            r.block_timestamp = new_block_timestamp;
+         });
+      }
    }
 }
 
@@ -19,16 +19,23 @@ namespace eosiosystem {
    using eosio::time_point_sec;
    using eosio::token;
 
+   /**
+    *  Fee taken on both sides of a ram trade, .5% rounded up.
+    */
+   static int64_t get_ram_fee( int64_t amount ) {
+      return ( amount + 199 ) / 200;
+   }
+
    /**
     *  This action will buy an exact amount of ram and bill the payer the current market price.
     */
-   void system_contract::buyrambytes( const name& payer, const name& receiver, uint32_t bytes ) {
+   action_return_buyram system_contract::buyrambytes( const name& payer, const name& receiver, uint32_t bytes ) {
       auto itr = _rammarket.find(ramcore_symbol.raw());
       const int64_t ram_reserve   = itr->base.balance.amount;
       const int64_t eos_reserve   = itr->quote.balance.amount;
       const int64_t cost          = exchange_state::get_bancor_input( ram_reserve, eos_reserve, bytes );
-      const int64_t cost_plus_fee = cost / double(0.995);
-      buyram( payer, receiver, asset{ cost_plus_fee, core_symbol() } );
+      const int64_t cost_plus_fee = int128_t(cost) * 200 / 199; // cost / 0.995
+      return buyram( payer, receiver, asset{ cost_plus_fee, core_symbol() } );
    }
 
 
@@ -40,7 +47,7 @@ namespace eosiosystem {
     *  RAM is a scarce resource whose supply is defined by global properties max_ram_size. RAM is
     *  priced using the bancor algorithm such that price-per-byte with a constant reserve ratio of 100:1.
     */
-   void system_contract::buyram( const name& payer, const name& receiver, const asset& quant )
+   action_return_buyram system_contract::buyram( const name& payer, const name& receiver, const asset& quant )
    {
       require_auth( payer );
       update_ram_supply();
@@ -49,7 +56,7 @@ namespace eosiosystem {
       check( quant.amount > 0, "must purchase a positive amount" );
 
       auto fee = quant;
-      fee.amount = ( fee.amount + 199 ) / 200; /// .5% fee (round up)
+      fee.amount = get_ram_fee( fee.amount ); /// .5% fee (round up)
       // fee.amount cannot be 0 since that is only possible if quant.amount is 0 which is not allowed by the assert above.
       // If quant.amount == 1, then fee.amount == 1,
       // otherwise if quant.amount > 1, then 0 < fee.amount < quant.amount.
@@ -78,6 +85,70 @@ namespace eosiosystem {
       _gstate.total_ram_bytes_reserved += uint64_t(bytes_out);
       _gstate.total_ram_stake          += quant_after_fee.amount;
 
+      const int64_t ram_bytes = add_ram( receiver, bytes_out );
+
+      return action_return_buyram{ payer, receiver, quant, bytes_out, ram_bytes, fee };
+   }
+
+   /**
+    *  Buys ram for each receiver like buyrambytes would, one after the other against the same market row,
+    *  and bills the payer with one transfer for the whole batch and one for its fees.
+    */
+   std::vector<action_return_buyram> system_contract::buyrammany( const name& payer, const std::vector<ram_purchase>& purchases )
+   {
+      require_auth( payer );
+      update_ram_supply();
+
+      check( !purchases.empty(), "purchases cannot be empty" );
+
+      std::vector<action_return_buyram> results;
+      results.reserve( purchases.size() );
+
+      asset total_after_fee( 0, core_symbol() );
+      asset total_fee( 0, core_symbol() );
+
+      const auto& market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+      _rammarket.modify( market, same_payer, [&]( auto& es ) {
+         for( const auto& p : purchases ) {
+            check( p.bytes > 0, "must purchase a positive amount" );
+
+            const int64_t cost          = exchange_state::get_bancor_input( es.base.balance.amount, es.quote.balance.amount, p.bytes );
+            const int64_t cost_plus_fee = int128_t(cost) * 200 / 199; // cost / 0.995
+            check( cost_plus_fee > 1, "must purchase a positive amount" );
+
+            const asset quant( cost_plus_fee, core_symbol() );
+            const asset fee( get_ram_fee( cost_plus_fee ), core_symbol() ); /// .5% fee (round up)
+            const asset quant_after_fee = quant - fee;
+
+            const int64_t bytes_out = es.direct_convert( quant_after_fee, ram_symbol ).amount;
+            check( bytes_out > 0, "must reserve a positive amount" );
+
+            total_after_fee += quant_after_fee;
+            total_fee       += fee;
+            results.push_back( action_return_buyram{ payer, p.receiver, quant, bytes_out, 0, fee } );
+         }
+      });
+
+      {
+         token::transfer_action transfer_act{ token_account, { {payer, active_permission}, {ram_account, active_permission} } };
+         transfer_act.send( payer, ram_account, total_after_fee, "buy ram" );
+      }
+      {
+         token::transfer_action transfer_act{ token_account, { {payer, active_permission} } };
+         transfer_act.send( payer, ramfee_account, total_fee, "ram fee" );
+      }
+
+      for( auto& r : results ) {
+         _gstate.total_ram_bytes_reserved += uint64_t(r.bytes_purchased);
+         r.ram_bytes = add_ram( r.receiver, r.bytes_purchased );
+      }
+      _gstate.total_ram_stake += total_after_fee.amount;
+
+      return results;
+   }
+
+   int64_t system_contract::add_ram( const name& receiver, int64_t bytes )
+   {
       user_resources_table  userres( get_self(), receiver.value );
       auto res_itr = userres.find( receiver.value );
       if( res_itr ==  userres.end() ) {
@@ -85,20 +156,55 @@ namespace eosiosystem {
                res.owner = receiver;
                res.net_weight = asset( 0, core_symbol() );
                res.cpu_weight = asset( 0, core_symbol() );
-               res.ram_bytes = bytes_out;
+               res.ram_bytes = bytes;
+               res.flags1.emplace( get_resource_flags( receiver, nullptr ) );
             });
       } else {
+         const uint32_t flags1 = get_resource_flags( receiver, &*res_itr );
          userres.modify( res_itr, receiver, [&]( auto& res ) {
-               res.ram_bytes += bytes_out;
+               res.ram_bytes += bytes;
+               res.flags1.emplace( flags1 );
             });
       }
 
-      auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+      if( !has_field( res_itr->flags1.value(), voter_info::flags1_fields::ram_managed ) ) {
          int64_t ram_bytes, net, cpu;
-         get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
-         set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
+         get_account_limits( res_itr->owner, ram_bytes, net, cpu );
+         set_account_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
+      }
+
+      return res_itr->ram_bytes;
+   }
+
+   /**
+    *  Prices a ram purchase exactly like buyram (or buyrambytes when bytes is given) would against the current
+    *  market, including the ram supply that buyram adds to the market before converting. Nothing is modified.
+    */
+   action_return_quoteram system_contract::quoteram( const std::optional<uint32_t>& bytes, const std::optional<asset>& quant ) {
+      check( bytes.has_value() != quant.has_value(), "exactly one of bytes and quant must be specified" );
+
+      exchange_state market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+
+      asset payment;
+      if( bytes ) {
+         // buyrambytes prices against the market before buyram updates the ram supply
+         const int64_t cost          = exchange_state::get_bancor_input( market.base.balance.amount, market.quote.balance.amount, *bytes );
+         const int64_t cost_plus_fee = int128_t(cost) * 200 / 199; // cost / 0.995
+         payment = asset{ cost_plus_fee, core_symbol() };
+      } else {
+         payment = *quant;
       }
+
+      check( payment.symbol == core_symbol(), "must buy ram with core token" );
+      check( payment.amount > 0, "must purchase a positive amount" );
+
+      market.base.balance.amount += get_pending_ram_supply();
+
+      const asset fee{ get_ram_fee( payment.amount ), core_symbol() };
+      const int64_t bytes_out = market.direct_convert( payment - fee, ram_symbol ).amount;
+      check( bytes_out > 0, "must reserve a positive amount" );
+
+      return action_return_quoteram{ payment, bytes_out, fee };
    }
 
   /**
@@ -107,7 +213,7 @@ namespace eosiosystem {
     *  tomorrow. Overall this will result in the market balancing the supply and demand
     *  for RAM over time.
     */
-   void system_contract::sellram( const name& account, int64_t bytes ) {
+   action_return_sellram system_contract::sellram( const name& account, int64_t bytes ) {
       require_auth( account );
       update_ram_supply();
 
@@ -133,27 +239,53 @@ namespace eosiosystem {
       //// this shouldn't happen, but just in case it does we should prevent it
       check( _gstate.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
 
+      const uint32_t flags1 = get_resource_flags( account, &*res_itr );
       userres.modify( res_itr, account, [&]( auto& res ) {
           res.ram_bytes -= bytes;
+          res.flags1.emplace( flags1 );
       });
 
-      auto voter_itr = _voters.find( res_itr->owner.value );
-      if( voter_itr == _voters.end() || !has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed ) ) {
+      if( !has_field( res_itr->flags1.value(), voter_info::flags1_fields::ram_managed ) ) {
          int64_t ram_bytes, net, cpu;
-         get_resource_limits( res_itr->owner, ram_bytes, net, cpu );
-         set_resource_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
+         get_account_limits( res_itr->owner, ram_bytes, net, cpu );
+         set_account_limits( res_itr->owner, res_itr->ram_bytes + ram_gift_bytes, net, cpu );
       }
 
       {
          token::transfer_action transfer_act{ token_account, { {ram_account, active_permission}, {account, active_permission} } };
          transfer_act.send( ram_account, account, asset(tokens_out), "sell ram" );
       }
-      auto fee = ( tokens_out.amount + 199 ) / 200; /// .5% fee (round up)
+      auto fee = get_ram_fee( tokens_out.amount ); /// .5% fee (round up)
       // since tokens_out.amount was asserted to be at least 2 earlier, fee.amount < tokens_out.amount
       if ( fee > 0 ) {
          token::transfer_action transfer_act{ token_account, { {account, active_permission} } };
          transfer_act.send( account, ramfee_account, asset(fee, core_symbol()), "sell ram fee" );
       }
+
+      return action_return_sellram{ account, tokens_out, bytes, res_itr->ram_bytes, asset(fee, core_symbol()) };
+   }
+
+   action_return_ramtransfer system_contract::ramtransfer( const name& from, const name& to, int64_t bytes ) {
+      require_auth( from );
+
+      check( from != to, "cannot transfer ram to self" );
+      check( eosio::is_account( to ), "to account does not exist" );
+      check( bytes > 0, "must transfer a positive amount" );
+
+      user_resources_table  userres( get_self(), from.value );
+      auto res_itr = userres.find( from.value );
+      check( res_itr != userres.end(), "no resource row" );
+      check( res_itr->ram_bytes >= bytes, "insufficient quota" );
+      check( !has_field( get_resource_flags( from, &*res_itr ), voter_info::flags1_fields::ram_managed ),
+             "cannot transfer ram from an account with managed ram" );
+
+      require_recipient( from );
+      require_recipient( to );
+
+      const int64_t from_ram_bytes = add_ram( from, -bytes );
+      const int64_t to_ram_bytes   = add_ram( to, bytes );
+
+      return action_return_ramtransfer{ from, to, bytes, from_ram_bytes, to_ram_bytes };
    }
 
    void validate_b1_vesting( int64_t stake ) {
@@ -164,20 +296,9 @@ namespace eosiosystem {
       check( max_claimable - claimable <= stake, "b1 can only claim their tokens over 10 years" );
    }
 
-   void system_contract::changebw( name from, const name& receiver,
-                                   const asset& stake_net_delta, const asset& stake_cpu_delta, bool transfer )
+   void system_contract::update_delegation( const name& from, const name& receiver,
+                                            const asset& stake_net_delta, const asset& stake_cpu_delta )
    {
-      require_auth( from );
-      check( stake_net_delta.amount != 0 || stake_cpu_delta.amount != 0, "should stake non-zero amount" );
-      check( std::abs( (stake_net_delta + stake_cpu_delta).amount )
-             >= std::max( std::abs( stake_net_delta.amount ), std::abs( stake_cpu_delta.amount ) ),
-             "net and cpu deltas cannot be opposite signs" );
-
-      name source_stake_from = from;
-      if ( transfer ) {
-         from = receiver;
-      }
-
       // update stake delegated from "from" to "receiver"
       {
          del_bandwidth_table     del_tbl( get_self(), from.value );
@@ -189,6 +310,10 @@ namespace eosiosystem {
                   dbo.net_weight    = stake_net_delta;
                   dbo.cpu_weight    = stake_cpu_delta;
                });
+            delegators_table delegators( get_self(), receiver.value );
+            delegators.emplace( from, [&]( auto& d ){
+                  d.from = from;
+               });
          }
          else {
             del_tbl.modify( itr, same_payer, [&]( auto& dbo ){
@@ -200,6 +325,11 @@ namespace eosiosystem {
          check( 0 <= itr->cpu_weight.amount, "insufficient staked cpu bandwidth" );
          if ( itr->is_empty() ) {
             del_tbl.erase( itr );
+            delegators_table delegators( get_self(), receiver.value );
+            auto d_itr = delegators.find( from.value );
+            if( d_itr != delegators.end() ) { // delegations created before the index have no row
+               delegators.erase( d_itr );
+            }
          }
       } // itr can be invalid, should go out of scope
 
@@ -212,36 +342,33 @@ namespace eosiosystem {
                   tot.owner = receiver;
                   tot.net_weight    = stake_net_delta;
                   tot.cpu_weight    = stake_cpu_delta;
+                  tot.flags1.emplace( get_resource_flags( receiver, nullptr ) );
                });
          } else {
+            const uint32_t flags1 = get_resource_flags( receiver, &*tot_itr );
             totals_tbl.modify( tot_itr, from == receiver ? from : same_payer, [&]( auto& tot ) {
                   tot.net_weight    += stake_net_delta;
                   tot.cpu_weight    += stake_cpu_delta;
+                  tot.flags1.emplace( flags1 );
                });
          }
          check( 0 <= tot_itr->net_weight.amount, "insufficient staked total net bandwidth" );
          check( 0 <= tot_itr->cpu_weight.amount, "insufficient staked total cpu bandwidth" );
 
          {
-            bool ram_managed = false;
-            bool net_managed = false;
-            bool cpu_managed = false;
-
-            auto voter_itr = _voters.find( receiver.value );
-            if( voter_itr != _voters.end() ) {
-               ram_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed );
-               net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
-               cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
-            }
+            const uint32_t flags1 = tot_itr->flags1.value();
+            bool ram_managed = has_field( flags1, voter_info::flags1_fields::ram_managed );
+            bool net_managed = has_field( flags1, voter_info::flags1_fields::net_managed );
+            bool cpu_managed = has_field( flags1, voter_info::flags1_fields::cpu_managed );
 
             if( !(net_managed && cpu_managed) ) {
                int64_t ram_bytes, net, cpu;
-               get_resource_limits( receiver, ram_bytes, net, cpu );
+               get_account_limits( receiver, ram_bytes, net, cpu );
 
-               set_resource_limits( receiver,
-                                    ram_managed ? ram_bytes : std::max( tot_itr->ram_bytes + ram_gift_bytes, ram_bytes ),
-                                    net_managed ? net : tot_itr->net_weight.amount,
-                                    cpu_managed ? cpu : tot_itr->cpu_weight.amount );
+               set_account_limits( receiver,
+                                   ram_managed ? ram_bytes : std::max( tot_itr->ram_bytes + ram_gift_bytes, ram_bytes ),
+                                   net_managed ? net : tot_itr->net_weight.amount,
+                                   cpu_managed ? cpu : tot_itr->cpu_weight.amount );
             }
          }
 
@@ -249,71 +376,96 @@ namespace eosiosystem {
             totals_tbl.erase( tot_itr );
          }
       } // tot_itr can be invalid, should go out of scope
+   }
 
-      // create refund or update from existing refund
-      if ( stake_account != source_stake_from ) { //for eosio both transfer and refund make no sense
-         refunds_table refunds_tbl( get_self(), from.value );
-         auto req = refunds_tbl.find( from.value );
+   // Nets the stake deltas of `owner` against its pending refund; returns the part of a stake increase that
+   // the refund could not cover and which must be transferred to the stake account
+   asset system_contract::update_refund( const name& owner, asset net_balance, asset cpu_balance )
+   {
+      refunds_table refunds_tbl( get_self(), owner.value );
+      auto req = refunds_tbl.find( owner.value );
+
+      if ( req != refunds_tbl.end() ) { //need to update refund
+         refunds_tbl.modify( req, same_payer, [&]( refund_request& r ) {
+            if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) {
+               r.request_time = current_time_point();
+            }
+            r.net_amount -= net_balance;
+            if ( r.net_amount.amount < 0 ) {
+               net_balance = -r.net_amount;
+               r.net_amount.amount = 0;
+            } else {
+               net_balance.amount = 0;
+            }
+            r.cpu_amount -= cpu_balance;
+            if ( r.cpu_amount.amount < 0 ){
+               cpu_balance = -r.cpu_amount;
+               r.cpu_amount.amount = 0;
+            } else {
+               cpu_balance.amount = 0;
+            }
+         });
+
+         check( 0 <= req->net_amount.amount, "negative net refund amount" ); //should never happen
+         check( 0 <= req->cpu_amount.amount, "negative cpu refund amount" ); //should never happen
+
+         if ( req->is_empty() ) {
+            dequeue_refund( owner );
+            refunds_tbl.erase( req );
+         } else {
+            queue_refund( *req );
+         }
+      } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
+         req = refunds_tbl.emplace( owner, [&]( refund_request& r ) {
+            r.owner = owner;
+            if ( net_balance.amount < 0 ) {
+               r.net_amount = -net_balance;
+               net_balance.amount = 0;
+            } else {
+               r.net_amount = asset( 0, core_symbol() );
+            }
+            if ( cpu_balance.amount < 0 ) {
+               r.cpu_amount = -cpu_balance;
+               cpu_balance.amount = 0;
+            } else {
+               r.cpu_amount = asset( 0, core_symbol() );
+            }
+            r.request_time = current_time_point();
+         });
+         queue_refund( *req );
+      } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
+
+      return net_balance + cpu_balance;
+   }
+
+   void system_contract::changebw( name from, const name& receiver,
+                                   const asset& stake_net_delta, const asset& stake_cpu_delta, bool transfer )
+   {
+      require_auth( from );
+      check( stake_net_delta.amount != 0 || stake_cpu_delta.amount != 0, "should stake non-zero amount" );
+      check( std::abs( (stake_net_delta + stake_cpu_delta).amount )
+             >= std::max( std::abs( stake_net_delta.amount ), std::abs( stake_cpu_delta.amount ) ),
+             "net and cpu deltas cannot be opposite signs" );
 
-         //create/update/delete refund
-         auto net_balance = stake_net_delta;
-         auto cpu_balance = stake_cpu_delta;
+      name source_stake_from = from;
+      if ( transfer ) {
+         from = receiver;
+      }
 
+      update_delegation( from, receiver, stake_net_delta, stake_cpu_delta );
 
+      // create refund or update from existing refund
+      if ( stake_account != source_stake_from ) { //for eosio both transfer and refund make no sense
          // net and cpu are same sign by assertions in delegatebw and undelegatebw
          // redundant assertion also at start of changebw to protect against misuse of changebw
-         bool is_undelegating = (net_balance.amount + cpu_balance.amount ) < 0;
+         bool is_undelegating = (stake_net_delta.amount + stake_cpu_delta.amount ) < 0;
          bool is_delegating_to_self = (!transfer && from == receiver);
 
+         auto transfer_amount = stake_net_delta + stake_cpu_delta;
          if( is_delegating_to_self || is_undelegating ) {
-            if ( req != refunds_tbl.end() ) { //need to update refund
-               refunds_tbl.modify( req, same_payer, [&]( refund_request& r ) {
-                  if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) {
-                     r.request_time = current_time_point();
-                  }
-                  r.net_amount -= net_balance;
-                  if ( r.net_amount.amount < 0 ) {
-                     net_balance = -r.net_amount;
-                     r.net_amount.amount = 0;
-                  } else {
-                     net_balance.amount = 0;
-                  }
-                  r.cpu_amount -= cpu_balance;
-                  if ( r.cpu_amount.amount < 0 ){
-                     cpu_balance = -r.cpu_amount;
-                     r.cpu_amount.amount = 0;
-                  } else {
-                     cpu_balance.amount = 0;
-                  }
-               });
-
-               check( 0 <= req->net_amount.amount, "negative net refund amount" ); //should never happen
-               check( 0 <= req->cpu_amount.amount, "negative cpu refund amount" ); //should never happen
-
-               if ( req->is_empty() ) {
-                  refunds_tbl.erase( req );
-               }
-            } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
-               refunds_tbl.emplace( from, [&]( refund_request& r ) {
-                  r.owner = from;
-                  if ( net_balance.amount < 0 ) {
-                     r.net_amount = -net_balance;
-                     net_balance.amount = 0;
-                  } else {
-                     r.net_amount = asset( 0, core_symbol() );
-                  }
-                  if ( cpu_balance.amount < 0 ) {
-                     r.cpu_amount = -cpu_balance;
-                     cpu_balance.amount = 0;
-                  } else {
-                     r.cpu_amount = asset( 0, core_symbol() );
-                  }
-                  r.request_time = current_time_point();
-               });
-            } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
-         } /// end if is_delegating_to_self || is_undelegating
+            transfer_amount = update_refund( from, stake_net_delta, stake_cpu_delta );
+         }
 
-         auto transfer_amount = net_balance + cpu_balance;
          if ( 0 < transfer_amount.amount ) {
             token::transfer_action transfer_act{ token_account, { {source_stake_from, active_permission} } };
             transfer_act.send( source_stake_from, stake_account, asset(transfer_amount), "stake bandwidth" );
@@ -335,6 +487,7 @@ namespace eosiosystem {
       check(req.net_amount + req.cpu_amount >= tokens, "account does not have enough staked tokens");
 
       if(req.net_amount + req.cpu_amount == tokens){
+         dequeue_refund(account);
          refunds_tbl.erase(req);
          return;
       }
@@ -430,6 +583,51 @@ namespace eosiosystem {
       transfer_act.send(genesis_account, claimer, payable_rewards, std::string("claimgenesis"));
    }
 
+   void system_contract::purgegenesis( uint32_t max )
+   {
+      require_auth( get_self() );
+      check( current_time_point() > gbm_final_time, "cannot purge genesis state before the end of GBM" );
+      check( max > 0, "max must be positive" );
+
+      // Once GBM is over nothing is burned on unstake anymore and the accrual of a genesis row stops at
+      // gbm_final_time, so leaving the remaining rows untouched by undelegatebw does not change what is owed.
+      _gstate4.genesis_retired = true;
+
+      genesis_nonce_table nonce_tbl( get_self(), get_self().value );
+      for( auto itr = nonce_tbl.begin(); itr != nonce_tbl.end() && 0 < max; --max ) {
+         settle_genesis( itr->receiver );
+         itr = nonce_tbl.erase( itr );
+      }
+   }
+
+   void system_contract::purgegenacct( const std::vector<name>& receivers )
+   {
+      require_auth( get_self() );
+      check( current_time_point() > gbm_final_time, "cannot purge genesis state before the end of GBM" );
+      check( !receivers.empty(), "receivers cannot be empty" );
+
+      _gstate4.genesis_retired = true;
+      for( const auto& receiver : receivers ) {
+         settle_genesis( receiver );
+      }
+   }
+
+   void system_contract::settle_genesis( const name& receiver )
+   {
+      genesis_balance_table genesis_tbl( get_self(), receiver.value );
+      auto genesis_itr = genesis_tbl.find( core_symbol().code().raw() );
+      if( genesis_itr == genesis_tbl.end() ) {
+         return;
+      }
+      const asset payable_rewards( get_unclaimed_gbm_balance( receiver ), core_symbol() );
+      genesis_tbl.erase( genesis_itr );
+
+      if( payable_rewards.amount > 0 ) {
+         token::transfer_action transfer_act{ token_account, { {genesis_account, active_permission} } };
+         transfer_act.send( genesis_account, receiver, payable_rewards, std::string("purgegenesis") );
+      }
+   }
+
    bool system_contract::has_genesis_balance( name owner )
    {
        genesis_balance_table genesis_tbl( _self, owner.value );
@@ -450,6 +648,11 @@ namespace eosiosystem {
      // and now we should check if receiver also has a genesis balance which might
      // be decreased by DIFF (above defined)
 
+     // GBM state has been retired by purgegenesis, there is nothing left to adjust
+     if( _gstate4.genesis_retired ) {
+       return;
+     }
+
      // Let's check receiver HAS a genesis balance
      if( has_genesis_balance(owner) ) {
 
@@ -529,8 +732,128 @@ namespace eosiosystem {
       change_genesis(receiver);
    } // undelegatebw
 
+   void system_contract::delegatebwmany( const name& from, const std::vector<bw_delegation>& delegations )
+   {
+      require_auth( from );
+      check( !delegations.empty(), "delegations cannot be empty" );
+
+      const asset zero_asset( 0, core_symbol() );
+      asset self_net = zero_asset;
+      asset self_cpu = zero_asset;
+      asset to_others = zero_asset;
+      for( const auto& d : delegations ) {
+         check( d.cpu >= zero_asset, "must stake a positive amount" );
+         check( d.net >= zero_asset, "must stake a positive amount" );
+         check( d.net.amount + d.cpu.amount > 0, "must stake a positive amount" );
+
+         update_delegation( from, d.receiver, d.net, d.cpu );
+         if( d.receiver == from ) {
+            self_net += d.net;
+            self_cpu += d.cpu;
+         } else {
+            to_others += d.net + d.cpu;
+         }
+      }
+
+      // only stake delegated to self can be taken back from a pending refund, same as delegatebw
+      if ( stake_account != from ) {
+         auto transfer_amount = to_others;
+         if( self_net.amount + self_cpu.amount > 0 ) {
+            transfer_amount += update_refund( from, self_net, self_cpu );
+         }
+         if ( 0 < transfer_amount.amount ) {
+            token::transfer_action transfer_act{ token_account, { {from, active_permission} } };
+            transfer_act.send( from, stake_account, transfer_amount, "stake bandwidth" );
+         }
+      }
+
+      const asset total = self_net + self_cpu + to_others;
+      _wps_state.total_stake += total.amount;
 
-   void system_contract::refund( const name& owner ) {
+      update_voting_power( from, total );
+   } // delegatebwmany
+
+   void system_contract::undelegatebwmany( const name& from, const std::vector<bw_delegation>& delegations )
+   {
+      require_auth( from );
+      check( !delegations.empty(), "delegations cannot be empty" );
+
+      const asset zero_asset( 0, core_symbol() );
+      for( const auto& d : delegations ) {
+         check( d.cpu >= zero_asset, "must unstake a positive amount" );
+         check( d.net >= zero_asset, "must unstake a positive amount" );
+         check( d.net.amount + d.cpu.amount > 0, "must unstake a positive amount" );
+      }
+
+      undelegate_many( from, delegations );
+   } // undelegatebwmany
+
+   name system_contract::undelegateall( const name& from, const name& cursor, uint16_t max )
+   {
+      require_auth( from );
+      check( max > 0, "max must be greater than 0" );
+
+      std::vector<bw_delegation> delegations;
+      del_bandwidth_table del_tbl( get_self(), from.value );
+      auto itr = del_tbl.lower_bound( cursor.value );
+      for( ; itr != del_tbl.end() && delegations.size() < max; ++itr ) {
+         delegations.push_back( bw_delegation{ itr->to, itr->net_weight, itr->cpu_weight } );
+      }
+      check( !delegations.empty(), "nothing to undelegate" );
+      const name next = itr != del_tbl.end() ? itr->to : name();
+
+      undelegate_many( from, delegations );
+
+      return next;
+   } // undelegateall
+
+   name system_contract::filldelegs( const name& from, const name& cursor, uint16_t max )
+   {
+      check( max > 0, "max must be greater than 0" );
+
+      del_bandwidth_table del_tbl( get_self(), from.value );
+      auto itr = del_tbl.lower_bound( cursor.value );
+      for( ; itr != del_tbl.end() && max > 0; ++itr, --max ) {
+         delegators_table delegators( get_self(), itr->to.value );
+         if( delegators.find( from.value ) == delegators.end() ) {
+            delegators.emplace( get_self(), [&]( auto& d ){
+                  d.from = from;
+               });
+         }
+      }
+      return itr != del_tbl.end() ? itr->to : name();
+   } // filldelegs
+
+   void system_contract::undelegate_many( const name& from, const std::vector<bw_delegation>& delegations )
+   {
+      check( _gstate.thresh_activated_stake_time != time_point(),
+             "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      const asset zero_asset( 0, core_symbol() );
+      asset net_total = zero_asset;
+      asset cpu_total = zero_asset;
+      for( const auto& d : delegations ) {
+         update_delegation( from, d.receiver, -d.net, -d.cpu );
+         net_total += d.net;
+         cpu_total += d.cpu;
+      }
+
+      if ( stake_account != from ) {
+         update_refund( from, -net_total, -cpu_total );
+      }
+
+      _wps_state.total_stake -= (net_total + cpu_total).amount;
+
+      update_voting_power( from, -(net_total + cpu_total) );
+
+      // deal with genesis balances
+      for( const auto& d : delegations ) {
+         change_genesis( d.receiver );
+      }
+   }
+
+
+   action_return_refund system_contract::refund( const name& owner ) {
       require_auth( owner );
 
       refunds_table refunds_tbl( get_self(), owner.value );
@@ -540,7 +863,89 @@ namespace eosiosystem {
              "refund is not available yet" );
       token::transfer_action transfer_act{ token_account, { {stake_account, active_permission}, {req->owner, active_permission} } };
       transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
+      const action_return_refund result{ req->owner, req->net_amount, req->cpu_amount };
+      dequeue_refund( owner );
       refunds_tbl.erase( req );
+      return result;
+   }
+
+   void system_contract::processrefunds( uint16_t max ) {
+      check( max > 0, "max must be greater than 0" );
+
+      refund_queue_table queue( get_self(), get_self().value );
+      auto idx = queue.get_index<"bymaturity"_n>();
+      const time_point_sec now = current_time_point();
+      for( auto itr = idx.begin(); max > 0 && itr != idx.end() && itr->matures <= now; --max ) {
+         refunds_table refunds_tbl( get_self(), itr->owner.value );
+         auto req = refunds_tbl.find( itr->owner.value );
+         if( req != refunds_tbl.end() ) {
+            token::transfer_action transfer_act{ token_account, { {stake_account, active_permission} } };
+            transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
+            refunds_tbl.erase( req );
+         }
+         itr = idx.erase( itr );
+      }
+   }
+
+   void system_contract::autorefund( const name& owner, bool enabled ) {
+      require_auth( owner );
+
+      auto_refunds_table auto_refunds( get_self(), get_self().value );
+      auto itr = auto_refunds.find( owner.value );
+      if( enabled ) {
+         if( itr == auto_refunds.end() ) {
+            auto_refunds.emplace( owner, [&]( auto& a ) {
+               a.owner = owner;
+            });
+         }
+         refunds_table refunds_tbl( get_self(), owner.value );
+         auto req = refunds_tbl.find( owner.value );
+         if( req != refunds_tbl.end() ) {
+            queue_refund( *req );
+         }
+      } else {
+         if( itr != auto_refunds.end() ) {
+            auto_refunds.erase( itr );
+         }
+         dequeue_refund( owner );
+      }
+   }
+
+   void system_contract::parkrefund( const name& owner ) {
+      refund_queue_table queue( get_self(), get_self().value );
+      auto itr = queue.find( owner.value );
+      check( itr != queue.end(), "refund is not queued" );
+      check( itr->matures <= current_time_point(), "refund is not due yet" );
+      queue.erase( itr );
+   }
+
+   void system_contract::queue_refund( const refund_request& req ) {
+      auto_refunds_table auto_refunds( get_self(), get_self().value );
+      if( auto_refunds.find( req.owner.value ) == auto_refunds.end() ) {
+         return;
+      }
+      const time_point_sec matures( req.request_time.sec_since_epoch() + refund_delay_sec );
+      refund_queue_table queue( get_self(), get_self().value );
+      auto itr = queue.find( req.owner.value );
+      if( itr == queue.end() ) {
+         // paid by the contract, so unstaking costs the owner no more RAM than before
+         queue.emplace( get_self(), [&]( auto& q ) {
+            q.owner   = req.owner;
+            q.matures = matures;
+         });
+      } else if( itr->matures != matures ) {
+         queue.modify( itr, same_payer, [&]( auto& q ) {
+            q.matures = matures;
+         });
+      }
+   }
+
+   void system_contract::dequeue_refund( const name& owner ) {
+      refund_queue_table queue( get_self(), get_self().value );
+      auto itr = queue.find( owner.value );
+      if( itr != queue.end() ) {
+         queue.erase( itr );
+      }
    }
 
 
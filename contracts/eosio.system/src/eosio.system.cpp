@@ -20,9 +20,11 @@ namespace eosiosystem {
     _global(get_self(), get_self().value),
     _global2(get_self(), get_self().value),
     _global3(get_self(), get_self().value),
+    _global4(get_self(), get_self().value),
     _rammarket(get_self(), get_self().value),
     _proposers(get_self(), get_self().value),
     _proposals(get_self(), get_self().value),
+    _proptally(get_self(), get_self().value),
     _committees(get_self(), get_self().value),
     _reviewers(get_self(), get_self().value),
     _wps_global(get_self(), get_self().value)
@@ -31,6 +33,7 @@ namespace eosiosystem {
       _gstate  = _global.exists() ? _global.get() : get_default_parameters();
       _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
       _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
+      _gstate4 = _global4.exists() ? _global4.get() : eosio_global_state4{};
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -45,10 +48,75 @@ namespace eosiosystem {
    }
 
    system_contract::~system_contract() {
+      flush_account_limits();
       _wps_global.set( _wps_state, get_self() );
       _global.set( _gstate, get_self() );
       _global2.set( _gstate2, get_self() );
       _global3.set( _gstate3, get_self() );
+      _global4.set( _gstate4, get_self() );
+   }
+
+   /**
+    *  Resource limits are read from the chain once per account and action; updates are kept here and
+    *  written by `flush_account_limits` when the action ends, so that an account gets at most one
+    *  `set_resource_limits` per action, and none when its limits did not change.
+    */
+   void system_contract::get_account_limits( const name& account, int64_t& ram_bytes, int64_t& net_weight, int64_t& cpu_weight ) {
+      auto itr = _account_limits.find( account );
+      if( itr == _account_limits.end() ) {
+         account_limits limits;
+         get_resource_limits( account, limits.ram_bytes, limits.net_weight, limits.cpu_weight );
+         itr = _account_limits.emplace( account, std::make_pair( limits, limits ) ).first;
+      }
+      ram_bytes  = itr->second.second.ram_bytes;
+      net_weight = itr->second.second.net_weight;
+      cpu_weight = itr->second.second.cpu_weight;
+   }
+
+   void system_contract::set_account_limits( const name& account, int64_t ram_bytes, int64_t net_weight, int64_t cpu_weight ) {
+      int64_t current_ram, current_net, current_cpu;
+      get_account_limits( account, current_ram, current_net, current_cpu );
+      _account_limits[account].second = account_limits{ ram_bytes, net_weight, cpu_weight };
+   }
+
+   void system_contract::flush_account_limits() {
+      for( const auto& [account, limits] : _account_limits ) {
+         if( limits.first == limits.second ) continue;
+         set_resource_limits( account, limits.second.ram_bytes, limits.second.net_weight, limits.second.cpu_weight );
+      }
+      _account_limits.clear();
+   }
+
+   /**
+    *  The managed-resource flags of an account live in its `voter_info::flags1`, and are copied into its
+    *  `user_resources::flags1` so that resource changes only need the resource row. Rows written before
+    *  that copy existed fall back on the voter row until they are next written.
+    */
+   uint32_t system_contract::get_resource_flags( const name& account, const user_resources* res )const {
+      if( res && res->flags1.has_value() ) {
+         return res->flags1.value();
+      }
+      auto voter_itr = _voters.find( account.value );
+      return voter_itr != _voters.end() ? voter_itr->flags1 : 0;
+   }
+
+   void system_contract::set_resource_flags( const name& account ) {
+      user_resources_table userres( get_self(), account.value );
+      auto ritr = userres.find( account.value );
+      if( ritr == userres.end() ) {
+         return;
+      }
+      const uint32_t flags1 = get_resource_flags( account, nullptr );
+      userres.modify( ritr, same_payer, [&]( auto& res ) {
+         res.flags1.emplace( flags1 );
+      });
+   }
+
+   void system_contract::migrateflags( const std::vector<name>& accounts ) {
+      require_auth( get_self() );
+      for( const auto& account : accounts ) {
+         set_resource_flags( account );
+      }
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
@@ -58,6 +126,8 @@ namespace eosiosystem {
       check( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
       check( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
 
+      update_ram_price_history();
+
       auto delta = int64_t(max_ram_size) - int64_t(_gstate.max_ram_size);
       auto itr = _rammarket.find(ramcore_symbol.raw());
 
@@ -71,13 +141,23 @@ namespace eosiosystem {
       _gstate.max_ram_size = max_ram_size;
    }
 
+   uint64_t system_contract::get_pending_ram_supply()const {
+      auto cbt = eosio::current_block_time();
+
+      if( cbt <= _gstate2.last_ram_increase ) return 0;
+
+      return (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
+   }
+
    void system_contract::update_ram_supply() {
+      update_ram_price_history();
+
       auto cbt = eosio::current_block_time();
 
       if( cbt <= _gstate2.last_ram_increase ) return;
 
       auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
+      auto new_ram = get_pending_ram_supply();
       _gstate.max_ram_size += new_ram;
 
       /**
@@ -89,6 +169,40 @@ namespace eosiosystem {
       _gstate2.last_ram_increase = cbt;
    }
 
+   /**
+    *  Accumulates the ram price in effect since the last change of the ram market, must be called before
+    *  the ram market changes. Adds a sample to the ring buffer at most once per `ram_price_sample_interval`.
+    */
+   void system_contract::update_ram_price_history() {
+      const time_point_sec now = eosio::current_time_point();
+
+      ram_price_history_singleton hist_sing( get_self(), get_self().value );
+      auto hist = hist_sing.get_or_default();
+      if( hist.samples.empty() ) {
+         hist.last = ram_price_sample{ now, 0 };
+         hist.samples.push_back( hist.last );
+         hist.head = 0;
+         hist_sing.set( hist, get_self() );
+         return;
+      }
+      if( now <= hist.last.time ) return; // the price is already accounted for up to now
+
+      const auto& market = _rammarket.get( ramcore_symbol.raw(), "ram market does not exist" );
+      hist.last.cumulative_price += get_ram_price( market ) * ( now.sec_since_epoch() - hist.last.time.sec_since_epoch() );
+      hist.last.time = now;
+
+      if( now.sec_since_epoch() - hist.samples[hist.head].time.sec_since_epoch() >= ram_price_sample_interval ) {
+         if( hist.samples.size() < ram_price_history_size ) {
+            hist.samples.push_back( hist.last );
+            hist.head = hist.samples.size() - 1;
+         } else {
+            hist.head = ( hist.head + 1 ) % ram_price_history_size;
+            hist.samples[hist.head] = hist.last;
+         }
+      }
+      hist_sing.set( hist, get_self() );
+   }
+
    void system_contract::setramrate( uint16_t bytes_per_block ) {
       require_auth( get_self() );
 
@@ -236,14 +350,14 @@ namespace eosiosystem {
          check( !(ram_managed || net_managed || cpu_managed), "cannot use setalimits on an account with managed resources" );
       }
 
-      set_resource_limits( account, ram, net, cpu );
+      set_account_limits( account, ram, net, cpu );
    }
 
    void system_contract::setacctram( const name& account, const std::optional<int64_t>& ram_bytes ) {
       require_auth( get_self() );
 
       int64_t current_ram, current_net, current_cpu;
-      get_resource_limits( account, current_ram, current_net, current_cpu );
+      get_account_limits( account, current_ram, current_net, current_cpu );
 
       int64_t ram = 0;
 
@@ -281,14 +395,15 @@ namespace eosiosystem {
          ram = *ram_bytes;
       }
 
-      set_resource_limits( account, ram, current_net, current_cpu );
+      set_resource_flags( account );
+      set_account_limits( account, ram, current_net, current_cpu );
    }
 
    void system_contract::setacctnet( const name& account, const std::optional<int64_t>& net_weight ) {
       require_auth( get_self() );
 
       int64_t current_ram, current_net, current_cpu;
-      get_resource_limits( account, current_ram, current_net, current_cpu );
+      get_account_limits( account, current_ram, current_net, current_cpu );
 
       int64_t net = 0;
 
@@ -325,14 +440,15 @@ namespace eosiosystem {
          net = *net_weight;
       }
 
-      set_resource_limits( account, current_ram, net, current_cpu );
+      set_resource_flags( account );
+      set_account_limits( account, current_ram, net, current_cpu );
    }
 
    void system_contract::setacctcpu( const name& account, const std::optional<int64_t>& cpu_weight ) {
       require_auth( get_self() );
 
       int64_t current_ram, current_net, current_cpu;
-      get_resource_limits( account, current_ram, current_net, current_cpu );
+      get_account_limits( account, current_ram, current_net, current_cpu );
 
       int64_t cpu = 0;
 
@@ -369,7 +485,8 @@ namespace eosiosystem {
          cpu = *cpu_weight;
       }
 
-      set_resource_limits( account, current_ram, current_net, cpu );
+      set_resource_flags( account );
+      set_account_limits( account, current_ram, current_net, cpu );
    }
 
    void system_contract::activate( const eosio::checksum256& feature_digest ) {
@@ -438,6 +555,7 @@ namespace eosiosystem {
         res.owner = new_account_name;
         res.net_weight = asset( 0, system_contract::get_core_symbol() );
         res.cpu_weight = asset( 0, system_contract::get_core_symbol() );
+        res.flags1.emplace( 0 );
       });
 
       set_resource_limits( new_account_name, 0, 0, 0 );
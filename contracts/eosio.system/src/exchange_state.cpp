@@ -3,6 +3,7 @@
 #include <eosio/check.hpp>
 
 #include <cmath>
+#include <limits>
 
 namespace eosiosystem {
 
@@ -82,29 +83,30 @@ namespace eosiosystem {
                                               int64_t out_reserve,
                                               int64_t inp )
    {
-      const double ib = inp_reserve;
-      const double ob = out_reserve;
-      const double in = inp;
+      // out = inp * out_reserve / (inp_reserve + inp), rounded down; the product of two int64_t fits in 128 bits
+      const int128_t ib_plus_in = int128_t(inp_reserve) + inp;
+      if ( inp <= 0 || ib_plus_in <= 0 ) return 0;
 
-      int64_t out = int64_t( (in * ob) / (ib + in) );
+      const int128_t out = int128_t(inp) * out_reserve / ib_plus_in;
+      if ( out < 0 ) return 0;
 
-      if ( out < 0 ) out = 0;
-
-      return out;
+      // out <= out_reserve since inp <= inp_reserve + inp
+      return int64_t(out);
    }
 
    int64_t exchange_state::get_bancor_input( int64_t out_reserve,
                                              int64_t inp_reserve,
                                              int64_t out )
    {
-      const double ob = out_reserve;
-      const double ib = inp_reserve;
-
-      int64_t inp = (ib * out) / (ob - out);
+      // inp = inp_reserve * out / (out_reserve - out), rounded down
+      check( out < out_reserve, "output exceeds the reserve of the market" );
+      if ( out <= 0 ) return 0;
 
-      if ( inp < 0 ) inp = 0;
+      const int128_t inp = int128_t(inp_reserve) * out / (int128_t(out_reserve) - out);
+      if ( inp < 0 ) return 0;
+      check( inp <= std::numeric_limits<int64_t>::max(), "input overflow" );
 
-      return inp;
+      return int64_t(inp);
    }
 
 } /// namespace eosiosystem
@@ -35,19 +35,7 @@ namespace eosiosystem {
          check( bid.amount - current->high_bid > (current->high_bid / 10), "must increase bid by 10%" );
          check( current->high_bidder != bidder, "account is already highest bidder" );
 
-         bid_refund_table refunds_table(get_self(), newname.value);
-
-         auto it = refunds_table.find( current->high_bidder.value );
-         if ( it != refunds_table.end() ) {
-            refunds_table.modify( it, same_payer, [&](auto& r) {
-                  r.amount += asset( current->high_bid, core_symbol() );
-               });
-         } else {
-            refunds_table.emplace( bidder, [&](auto& r) {
-                  r.bidder = current->high_bidder;
-                  r.amount = asset( current->high_bid, core_symbol() );
-               });
-         }
+         add_bid_refund( bidder, current->high_bidder, newname, asset( current->high_bid, core_symbol() ) );
 
          bids.modify( current, bidder, [&]( auto& b ) {
             b.high_bidder = bidder;
@@ -55,6 +43,7 @@ namespace eosiosystem {
             b.last_bid_time = current_time_point();
          });
       }
+      update_name_candidate( newname, bid.amount, current_time_point() );
    }
 
    void system_contract::bidrefund( const name& bidder, const name& newname ) {
@@ -65,6 +54,109 @@ namespace eosiosystem {
       token::transfer_action transfer_act{ token_account, { {names_account, active_permission}, {bidder, active_permission} } };
       transfer_act.send( names_account, bidder, asset(it->amount), std::string("refund bid on name ")+(name{newname}).to_string() );
       refunds_table.erase( it );
+
+      bidder_refund_table bidder_refunds(get_self(), bidder.value);
+      auto bidder_it = bidder_refunds.find( newname.value );
+      if ( bidder_it != bidder_refunds.end() ) {
+         bidder_refunds.erase( bidder_it );
+      }
+   }
+
+   void system_contract::bidrefunds( const name& bidder, uint16_t max ) {
+      check( max > 0, "max must be greater than 0" );
+
+      bidder_refund_table bidder_refunds(get_self(), bidder.value);
+      asset total( 0, core_symbol() );
+      for ( auto bidder_it = bidder_refunds.begin(); bidder_it != bidder_refunds.end() && max > 0; --max ) {
+         bid_refund_table refunds_table(get_self(), bidder_it->newname.value);
+         auto it = refunds_table.find( bidder.value );
+         if ( it != refunds_table.end() ) {
+            total += it->amount;
+            refunds_table.erase( it );
+         }
+         bidder_it = bidder_refunds.erase( bidder_it );
+      }
+      check( total.amount > 0, "refund not found" );
+
+      token::transfer_action transfer_act{ token_account, { {names_account, active_permission}, {bidder, active_permission} } };
+      transfer_act.send( names_account, bidder, total, std::string("refund bids on names") );
+   }
+
+   name system_contract::prunebids( const name& cursor, uint16_t max ) {
+      check( max > 0, "max must be greater than 0" );
+      check( _gstate4.bid_prune_grace_sec > 0, "bid pruning is disabled" );
+
+      const time_point expired = current_time_point() - eosio::seconds(_gstate4.bid_prune_grace_sec);
+      name_bid_table bids(get_self(), get_self().value);
+      auto it = bids.lower_bound( cursor.value );
+      for ( ; it != bids.end() && max > 0; --max ) {
+         if ( it->high_bid < 0 && it->last_bid_time < expired ) {
+            add_bid_refund( get_self(), it->high_bidder, it->newname, asset( -it->high_bid, core_symbol() ) );
+            it = bids.erase( it );
+         } else {
+            ++it;
+         }
+      }
+      return it != bids.end() ? it->newname : name();
+   }
+
+   void system_contract::cfgbidprune( uint32_t grace_sec ) {
+      require_auth( get_self() );
+      check( grace_sec == 0 || grace_sec >= min_bid_prune_grace_sec, "grace period is too short" );
+      _gstate4.bid_prune_grace_sec = grace_sec;
+   }
+
+   void system_contract::update_name_candidate( const name& newname, int64_t high_bid, time_point last_bid_time ) {
+      // until `onblock` has looked for the candidate once, it is not known which auction has the highest bid
+      if ( !_gstate4.name_candidate_valid ) {
+         return;
+      }
+      // same order as the `highbid` index: highest bid first, ties broken by name
+      if ( newname == _gstate4.name_candidate || high_bid > _gstate4.name_candidate_bid ||
+           (high_bid == _gstate4.name_candidate_bid && newname.value < _gstate4.name_candidate.value) ) {
+         _gstate4.name_candidate = newname;
+         _gstate4.name_candidate_bid = high_bid;
+         _gstate4.name_candidate_bid_time = last_bid_time;
+      }
+   }
+
+   void system_contract::refresh_name_candidate() {
+      name_bid_table bids(get_self(), get_self().value);
+      auto idx = bids.get_index<"highbid"_n>();
+      auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
+      if ( highest != idx.end() && highest->high_bid > 0 ) {
+         _gstate4.name_candidate = highest->newname;
+         _gstate4.name_candidate_bid = highest->high_bid;
+         _gstate4.name_candidate_bid_time = highest->last_bid_time;
+      } else {
+         _gstate4.name_candidate = name();
+         _gstate4.name_candidate_bid = 0;
+         _gstate4.name_candidate_bid_time = time_point();
+      }
+      _gstate4.name_candidate_valid = true;
+   }
+
+   void system_contract::add_bid_refund( const name& payer, const name& bidder, const name& newname, const asset& amount ) {
+      bid_refund_table refunds_table(get_self(), newname.value);
+
+      auto it = refunds_table.find( bidder.value );
+      if ( it != refunds_table.end() ) {
+         refunds_table.modify( it, same_payer, [&](auto& r) {
+               r.amount += amount;
+            });
+      } else {
+         refunds_table.emplace( payer, [&](auto& r) {
+               r.bidder = bidder;
+               r.amount = amount;
+            });
+      }
+
+      bidder_refund_table bidder_refunds(get_self(), bidder.value);
+      if ( bidder_refunds.find( newname.value ) == bidder_refunds.end() ) {
+         bidder_refunds.emplace( payer, [&](auto& r) {
+               r.newname = newname;
+            });
+      }
    }
 
 }
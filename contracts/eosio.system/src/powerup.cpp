@@ -31,35 +31,32 @@ void system_contract::adjust_resources(name payer, name account, symbol core_sym
          tot.owner      = account;
          tot.net_weight = asset{ net_delta, core_symbol };
          tot.cpu_weight = asset{ cpu_delta, core_symbol };
+         tot.flags1.emplace(get_resource_flags(account, nullptr));
       });
    } else {
+      const uint32_t flags1 = get_resource_flags(account, &*tot_itr);
       totals_tbl.modify(tot_itr, same_payer, [&](auto& tot) {
          tot.net_weight.amount += net_delta;
          tot.cpu_weight.amount += cpu_delta;
+         tot.flags1.emplace(flags1);
       });
    }
    check(0 <= tot_itr->net_weight.amount, "insufficient staked total net bandwidth");
    check(0 <= tot_itr->cpu_weight.amount, "insufficient staked total cpu bandwidth");
 
    {
-      bool ram_managed = false;
-      bool net_managed = false;
-      bool cpu_managed = false;
-
-      auto voter_itr = _voters.find(account.value);
-      if (voter_itr != _voters.end()) {
-         ram_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::ram_managed);
-         net_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::net_managed);
-         cpu_managed = has_field(voter_itr->flags1, voter_info::flags1_fields::cpu_managed);
-      }
+      const uint32_t flags1      = tot_itr->flags1.value();
+      bool           ram_managed = has_field(flags1, voter_info::flags1_fields::ram_managed);
+      bool           net_managed = has_field(flags1, voter_info::flags1_fields::net_managed);
+      bool           cpu_managed = has_field(flags1, voter_info::flags1_fields::cpu_managed);
 
       if (must_not_be_managed)
          eosio::check(!net_managed && !cpu_managed, "something is managed which shouldn't be");
 
       if (!(net_managed && cpu_managed)) {
          int64_t ram_bytes, net, cpu;
-         get_resource_limits(account, ram_bytes, net, cpu);
-         set_resource_limits(
+         get_account_limits(account, ram_bytes, net, cpu);
+         set_account_limits(
                account, ram_managed ? ram_bytes : std::max(tot_itr->ram_bytes + ram_gift_bytes, ram_bytes),
                net_managed ? net : tot_itr->net_weight.amount, cpu_managed ? cpu : tot_itr->cpu_weight.amount);
       }
@@ -72,18 +69,70 @@ void system_contract::adjust_resources(name payer, name account, symbol core_sym
 
 void system_contract::process_powerup_queue(time_point_sec now, symbol core_symbol, powerup_state& state,
                                            powerup_order_table& orders, uint32_t max_items, int64_t& net_delta_available,
-                                           int64_t& cpu_delta_available) {
+                                           int64_t& cpu_delta_available, bool dry_run) {
    update_utilization(now, state.net);
    update_utilization(now, state.cpu);
+   // orders placed before the expiry wheel, retired in expiry order until none are left
    auto idx = orders.get_index<"byexpires"_n>();
-   while (max_items--) {
-      auto it = idx.begin();
-      if (it == idx.end() || it->expires > now)
-         break;
+   auto it  = idx.begin();
+   while (max_items && it != idx.end() && it->expires <= now) {
+      --max_items;
       net_delta_available += it->net_weight;
       cpu_delta_available += it->cpu_weight;
-      adjust_resources(get_self(), it->owner, core_symbol, -it->net_weight, -it->cpu_weight);
-      idx.erase(it);
+      if (dry_run) {
+         ++it;
+      } else {
+         adjust_resources(get_self(), it->owner, core_symbol, -it->net_weight, -it->cpu_weight);
+         it = idx.erase(it);
+      }
+   }
+
+   // buckets are visited by expiry day, a bucket of a past day only holds expired orders
+   powerup_bucket_table buckets{ get_self(), 0 };
+   const uint32_t       today = now.utc_seconds / seconds_per_day;
+   auto                 bucket = buckets.begin();
+   while (max_items && bucket != buckets.end() && bucket->day <= today) {
+      powerup_merge_table merged{ get_self(), bucket->day };
+      powerup_queue_table queue{ get_self(), bucket->day };
+      int64_t             net_weight = 0;
+      int64_t             cpu_weight = 0;
+      uint32_t            retired    = 0;
+      // merged orders expire at the start of the day, before any order of the queue
+      for (auto order = merged.begin(); max_items && order != merged.end(); --max_items) {
+         net_weight += order->net_weight;
+         cpu_weight += order->cpu_weight;
+         ++retired;
+         if (dry_run) {
+            ++order;
+         } else {
+            adjust_resources(get_self(), order->owner, core_symbol, -order->net_weight, -order->cpu_weight);
+            order = merged.erase(order);
+         }
+      }
+      // ids follow the order of placement, which no longer matches expiry once `powerup_days` changes
+      auto queue_idx = queue.get_index<"byexpires"_n>();
+      for (auto order = queue_idx.begin(); max_items && order != queue_idx.end() && order->expires <= now; --max_items) {
+         net_weight += order->net_weight;
+         cpu_weight += order->cpu_weight;
+         ++retired;
+         if (dry_run) {
+            ++order;
+         } else {
+            adjust_resources(get_self(), order->owner, core_symbol, -order->net_weight, -order->cpu_weight);
+            order = queue_idx.erase(order);
+         }
+      }
+      net_delta_available += net_weight;
+      cpu_delta_available += cpu_weight;
+
+      if (retired < bucket->orders) {
+         // the rest of the bucket has not expired yet or is left for the next call
+         if (!dry_run) {
+            buckets.modify(bucket, same_payer, [&](auto& b) { b.orders -= retired; });
+         }
+         break;
+      }
+      bucket = dry_run ? std::next(bucket) : buckets.erase(bucket);
    }
    state.net.utilization -= net_delta_available;
    state.cpu.utilization -= cpu_delta_available;
@@ -91,6 +140,82 @@ void system_contract::process_powerup_queue(time_point_sec now, symbol core_symb
    update_weight(now, state.cpu, cpu_delta_available);
 }
 
+/**
+ *  Queues an order in the bucket of its expiry day, merged into the order of `owner` if merging is enabled.
+ *
+ *  @returns the expiry of the order, rounded up to the day when merging
+ */
+time_point_sec system_contract::queue_powerup_order(name payer, name owner, int64_t net_weight, int64_t cpu_weight,
+                                                    time_point_sec expires) {
+   if (_gstate4.powerup_merge_orders) {
+      expires = time_point_sec((expires.utc_seconds + seconds_per_day - 1) / seconds_per_day * seconds_per_day);
+   }
+   const uint32_t day = expires.utc_seconds / seconds_per_day;
+
+   uint32_t new_orders = 1;
+   if (_gstate4.powerup_merge_orders) {
+      powerup_merge_table merged{ get_self(), day };
+      auto                order = merged.find(owner.value);
+      if (order == merged.end()) {
+         merged.emplace(payer, [&](auto& o) {
+            o.owner      = owner;
+            o.net_weight = net_weight;
+            o.cpu_weight = cpu_weight;
+         });
+      } else {
+         merged.modify(order, same_payer, [&](auto& o) {
+            o.net_weight += net_weight;
+            o.cpu_weight += cpu_weight;
+         });
+         new_orders = 0;
+      }
+   } else {
+      powerup_queue_table queue{ get_self(), day };
+      queue.emplace(payer, [&](auto& order) {
+         order.id         = queue.available_primary_key();
+         order.owner      = owner;
+         order.net_weight = net_weight;
+         order.cpu_weight = cpu_weight;
+         order.expires    = expires;
+      });
+   }
+
+   powerup_bucket_table buckets{ get_self(), 0 };
+   auto                 bucket = buckets.find(day);
+   if (bucket == buckets.end()) {
+      buckets.emplace(get_self(), [&](auto& b) {
+         b.day    = day;
+         b.orders = new_orders;
+      });
+   } else {
+      buckets.modify(bucket, same_payer, [&](auto& b) { b.orders += new_orders; });
+   }
+   return expires;
+}
+
+/**
+ *  Adds `net_delta` and `cpu_delta` to the pending weight changes of `eosio.reserv`, and applies the pending changes to
+ *  its resources when `sync` is set, when one of them exceeds 1/sync_div of its market weight or when they were last
+ *  applied sync_secs ago. The total weight of the chain is thus off by at most that fraction of the markets, for at
+ *  most that long, while most powerups don't rewrite the reserve's resources.
+ */
+void system_contract::adjust_reserve(powerup_state& state, time_point_sec now, symbol core_symbol, int64_t net_delta,
+                                     int64_t cpu_delta, bool sync) {
+   if (!state.reserve_sync.has_value())
+      state.reserve_sync.emplace(powerup_reserve_sync{ 0, 0, now });
+   auto& pending = state.reserve_sync.value();
+   pending.net_delta += net_delta;
+   pending.cpu_delta += cpu_delta;
+
+   sync = sync || now >= pending.last_sync + powerup_reserve_sync::sync_secs ||
+          std::abs(pending.net_delta) > state.net.weight / powerup_reserve_sync::sync_div ||
+          std::abs(pending.cpu_delta) > state.cpu.weight / powerup_reserve_sync::sync_div;
+   if (sync) {
+      adjust_resources(get_self(), reserve_account, core_symbol, pending.net_delta, pending.cpu_delta, true);
+      pending = powerup_reserve_sync{ 0, 0, now };
+   }
+}
+
 void update_weight(time_point_sec now, powerup_state_resource& res, int64_t& delta_available) {
    if (now >= res.target_timestamp) {
       res.weight_ratio = res.target_weight_ratio;
@@ -105,6 +230,44 @@ void update_weight(time_point_sec now, powerup_state_resource& res, int64_t& del
    res.weight = new_weight;
 }
 
+/**
+ *  Returns e^(-num / den) as a fixed-point number with 62 fractional bits, without floating point.
+ *
+ *  The integral part of the exponent is applied with a table of e^(-2^i) and the fractional part with its Taylor
+ *  series. Each of the at most 22 series terms, 6 products and 6 table entries is off by less than 2^-62, so the
+ *  result is within 2^-57 of the exact value, and `diff * result >> 62` within 1 + diff * 2^-57 of diff * e^(-num / den).
+ *
+ *  @pre 0 < den
+ */
+uint64_t exp_neg_fixed(uint64_t num, uint64_t den) {
+   static constexpr uint64_t one              = uint64_t(1) << 62;
+   static constexpr uint64_t exp_neg_pow2[6]  = { 1696544475317221319ull, // e^-1
+                                                  624123833502197200ull,  // e^-2
+                                                  84465975781740359ull,   // e^-4
+                                                  1547048310802923ull,    // e^-8
+                                                  518976891834ull,        // e^-16
+                                                  58403ull };             // e^-32
+   const uint64_t whole = num / den;
+   if (whole >= 64)
+      return 0;
+
+   // e^-x = 1 - x + x^2/2! - x^3/3! + ... for x in [0, 1), until the terms truncate to 0
+   const uint64_t x      = (uint128_t(num % den) << 62) / den;
+   uint64_t       term   = one;
+   int64_t        result = one;
+   for (uint64_t n = 1; term; ++n) {
+      term = uint64_t((uint128_t(term) * x) >> 62) / n;
+      result += (n & 1) ? -int64_t(term) : int64_t(term);
+   }
+
+   uint64_t value = result;
+   for (uint32_t i = 0; i < 6; ++i) {
+      if (whole & (1 << i))
+         value = (uint128_t(value) * exp_neg_pow2[i]) >> 62;
+   }
+   return value;
+}
+
 void update_utilization(time_point_sec now, powerup_state_resource& res) {
    if (now <= res.utilization_timestamp) return;
 
@@ -112,7 +275,8 @@ void update_utilization(time_point_sec now, powerup_state_resource& res) {
       res.adjusted_utilization = res.utilization;
    } else {
       int64_t diff  = res.adjusted_utilization - res.utilization;
-      int64_t delta = diff * std::exp(-double(now.utc_seconds - res.utilization_timestamp.utc_seconds) / double(res.decay_secs));
+      int64_t delta = (uint128_t(diff) *
+                       exp_neg_fixed(now.utc_seconds - res.utilization_timestamp.utc_seconds, res.decay_secs)) >> 62;
       delta = std::clamp( delta, 0ll, diff);
       res.adjusted_utilization = res.utilization + delta;
    }
@@ -251,11 +415,14 @@ void system_contract::cfgpowerup(powerup_config& args) {
    state.net.adjusted_utilization = std::min(state.net.adjusted_utilization, state.net.weight);
    state.cpu.adjusted_utilization = std::min(state.cpu.adjusted_utilization, state.cpu.weight);
 
-   adjust_resources(get_self(), reserve_account, core_symbol, net_delta_available, cpu_delta_available, true);
+   adjust_reserve(state, now, core_symbol, net_delta_available, cpu_delta_available, true);
    state_sing.set(state, get_self());
 }
 
 /**
+ *  Unlike the utilization decay, the fee is still computed in floating point with `std::pow`, so existing fees don't
+ *  change. An integral kernel would need 256-bit intermediates for exponents above 2.
+ *
  *  @pre 0 <= state.min_price.amount <= state.max_price.amount
  *  @pre 0 < state.max_price.amount
  *  @pre 1.0 <= state.exponent
@@ -317,6 +484,49 @@ int64_t calc_powerup_fee(const powerup_state_resource& state, int64_t utilizatio
    return std::ceil(fee);
 }
 
+void check_powerup_fracs(int64_t net_frac, int64_t cpu_frac) {
+   eosio::check(net_frac >= 0, "net_frac can't be negative");
+   eosio::check(cpu_frac >= 0, "cpu_frac can't be negative");
+   eosio::check(net_frac <= powerup_frac, "net can't be more than 100%");
+   eosio::check(cpu_frac <= powerup_frac, "cpu can't be more than 100%");
+}
+
+/**
+ *  Reserves `frac` of the resource market `state` and adds its price to `fee`. Leaves `state` and `fee`
+ *  unchanged when `frac` can't be reserved.
+ *
+ *  @returns nullptr on success, the reason `frac` can't be reserved otherwise
+ */
+const char* try_reserve_powerup(int64_t frac, powerup_state_resource& state, asset& fee, int64_t& amount) {
+   amount = 0;
+   if (!frac)
+      return nullptr;
+   if (!state.weight)
+      return "market doesn't have resources available";
+   int64_t a = int128_t(frac) * state.weight / powerup_frac;
+   if (state.utilization + a > state.weight)
+      return "market doesn't have enough resources available";
+   int64_t f = calc_powerup_fee(state, a);
+   if (f <= 0)
+      return "calculated fee is below minimum; try powering up with more resources";
+   fee.amount += f;
+   state.utilization += a;
+   amount = a;
+   return nullptr;
+}
+
+/**
+ *  Same as `try_reserve_powerup`, except that it fails the action when `frac` can't be reserved.
+ *
+ *  @returns the reserved weight
+ */
+int64_t reserve_powerup(int64_t frac, powerup_state_resource& state, asset& fee) {
+   int64_t     amount;
+   const char* error = try_reserve_powerup(frac, state, fee, amount);
+   eosio::check(!error, error);
+   return amount;
+}
+
 void system_contract::powerupexec(const name& user, uint16_t max) {
    require_auth(user);
    powerup_state_singleton state_sing{ get_self(), 0 };
@@ -330,12 +540,12 @@ void system_contract::powerupexec(const name& user, uint16_t max) {
    int64_t cpu_delta_available = 0;
    process_powerup_queue(now, core_symbol, state, orders, max, net_delta_available, cpu_delta_available);
 
-   adjust_resources(get_self(), reserve_account, core_symbol, net_delta_available, cpu_delta_available, true);
+   adjust_reserve(state, now, core_symbol, net_delta_available, cpu_delta_available, false);
    state_sing.set(state, get_self());
 }
 
-void system_contract::powerup(const name& payer, const name& receiver, uint32_t days, int64_t net_frac, int64_t cpu_frac,
-                             const asset& max_payment) {
+action_return_powerup system_contract::powerup(const name& payer, const name& receiver, uint32_t days, int64_t net_frac,
+                                              int64_t cpu_frac, const asset& max_payment) {
    require_auth(payer);
    powerup_state_singleton state_sing{ get_self(), 0 };
    powerup_order_table     orders{ get_self(), 0 };
@@ -345,32 +555,15 @@ void system_contract::powerup(const name& payer, const name& receiver, uint32_t
    auto           core_symbol = get_core_symbol();
    eosio::check(max_payment.symbol == core_symbol, "max_payment doesn't match core symbol");
    eosio::check(days == state.powerup_days, "days doesn't match configuration");
-   eosio::check(net_frac >= 0, "net_frac can't be negative");
-   eosio::check(cpu_frac >= 0, "cpu_frac can't be negative");
-   eosio::check(net_frac <= powerup_frac, "net can't be more than 100%");
-   eosio::check(cpu_frac <= powerup_frac, "cpu can't be more than 100%");
+   check_powerup_fracs(net_frac, cpu_frac);
 
    int64_t net_delta_available = 0;
    int64_t cpu_delta_available = 0;
    process_powerup_queue(now, core_symbol, state, orders, 2, net_delta_available, cpu_delta_available);
 
    eosio::asset fee{ 0, core_symbol };
-   auto         process = [&](int64_t frac, int64_t& amount, powerup_state_resource& state) {
-      if (!frac)
-         return;
-      amount = int128_t(frac) * state.weight / powerup_frac;
-      eosio::check(state.weight, "market doesn't have resources available");
-      eosio::check(state.utilization + amount <= state.weight, "market doesn't have enough resources available");
-      int64_t f = calc_powerup_fee(state, amount);
-      eosio::check(f > 0, "calculated fee is below minimum; try powering up with more resources");
-      fee.amount += f;
-      state.utilization += amount;
-   };
-
-   int64_t net_amount = 0;
-   int64_t cpu_amount = 0;
-   process(net_frac, net_amount, state.net);
-   process(cpu_frac, cpu_amount, state.cpu);
+   int64_t      net_amount = reserve_powerup(net_frac, state.net, fee);
+   int64_t      cpu_amount = reserve_powerup(cpu_frac, state.cpu, fee);
    if (fee > max_payment) {
       std::string error_msg = "max_payment is less than calculated fee: ";
       error_msg += fee.to_string();
@@ -378,18 +571,12 @@ void system_contract::powerup(const name& payer, const name& receiver, uint32_t
    }
    eosio::check(fee >= state.min_powerup_fee, "calculated fee is below minimum; try powering up with more resources");
 
-   orders.emplace(payer, [&](auto& order) {
-      order.id         = orders.available_primary_key();
-      order.owner      = receiver;
-      order.net_weight = net_amount;
-      order.cpu_weight = cpu_amount;
-      order.expires    = now + eosio::days(days);
-   });
+   queue_powerup_order(payer, receiver, net_amount, cpu_amount, now + eosio::days(days));
    net_delta_available -= net_amount;
    cpu_delta_available -= cpu_amount;
 
    adjust_resources(payer, receiver, core_symbol, net_amount, cpu_amount, true);
-   adjust_resources(get_self(), reserve_account, core_symbol, net_delta_available, cpu_delta_available, true);
+   adjust_reserve(state, now, core_symbol, net_delta_available, cpu_delta_available, false);
 
    token::transfer_action transfer_act{ token_account, { payer, active_permission } };
    transfer_act.send( payer, fees_account, fee,
@@ -397,9 +584,228 @@ void system_contract::powerup(const name& payer, const name& receiver, uint32_t
 
    state_sing.set(state, get_self());
 
-   // inline noop action
-   powup_results::powupresult_action powupresult_act{ reserve_account, std::vector<eosio::permission_level>{ } };
-   powupresult_act.send( fee, net_amount, cpu_amount );
+   if (!_gstate4.powupresult_disabled) {
+      // inline noop action
+      powup_results::powupresult_action powupresult_act{ reserve_account, std::vector<eosio::permission_level>{ } };
+      powupresult_act.send( fee, net_amount, cpu_amount );
+   }
+
+   return action_return_powerup{ fee, net_amount, cpu_amount };
+}
+
+std::vector<action_return_powerup> system_contract::powerupmany(const name& payer,
+                                                              const std::vector<powerup_request>& requests,
+                                                              const asset& max_payment) {
+   require_auth(payer);
+   powerup_state_singleton state_sing{ get_self(), 0 };
+   powerup_order_table     orders{ get_self(), 0 };
+   eosio::check(state_sing.exists(), "powerup hasn't been initialized");
+   eosio::check(!requests.empty(), "requests cannot be empty");
+   auto           state       = state_sing.get();
+   time_point_sec now         = eosio::current_time_point();
+   auto           core_symbol = get_core_symbol();
+   eosio::check(max_payment.symbol == core_symbol, "max_payment doesn't match core symbol");
+
+   int64_t net_delta_available = 0;
+   int64_t cpu_delta_available = 0;
+   process_powerup_queue(now, core_symbol, state, orders, 2, net_delta_available, cpu_delta_available);
+
+   std::vector<action_return_powerup> results;
+   results.reserve(requests.size());
+   eosio::asset total_fee{ 0, core_symbol };
+   for (const auto& r : requests) {
+      check_powerup_fracs(r.net_frac, r.cpu_frac);
+
+      eosio::asset fee{ 0, core_symbol };
+      int64_t      net_amount = reserve_powerup(r.net_frac, state.net, fee);
+      int64_t      cpu_amount = reserve_powerup(r.cpu_frac, state.cpu, fee);
+      eosio::check(fee >= state.min_powerup_fee, "calculated fee is below minimum; try powering up with more resources");
+
+      queue_powerup_order(payer, r.receiver, net_amount, cpu_amount, now + eosio::days(state.powerup_days));
+      net_delta_available -= net_amount;
+      cpu_delta_available -= cpu_amount;
+      adjust_resources(payer, r.receiver, core_symbol, net_amount, cpu_amount, true);
+
+      total_fee += fee;
+      results.push_back(action_return_powerup{ fee, net_amount, cpu_amount });
+   }
+   if (total_fee > max_payment) {
+      std::string error_msg = "max_payment is less than calculated fee: ";
+      error_msg += total_fee.to_string();
+      eosio::check(false, error_msg);
+   }
+
+   adjust_reserve(state, now, core_symbol, net_delta_available, cpu_delta_available, false);
+
+   token::transfer_action transfer_act{ token_account, { payer, active_permission } };
+   transfer_act.send( payer, fees_account, total_fee,
+                            std::string("powerup fee from ") + payer.to_string() );
+
+   state_sing.set(state, get_self());
+   return results;
+}
+
+action_return_powerup system_contract::quotepowerup(int64_t net_frac, int64_t cpu_frac) {
+   powerup_state_singleton state_sing{ get_self(), 0 };
+   powerup_order_table     orders{ get_self(), 0 };
+   eosio::check(state_sing.exists(), "powerup hasn't been initialized");
+   auto           state       = state_sing.get();
+   time_point_sec now         = eosio::current_time_point();
+   auto           core_symbol = get_core_symbol();
+   check_powerup_fracs(net_frac, cpu_frac);
+
+   // account for the expired orders powerup would retire, without retiring them
+   int64_t net_delta_available = 0;
+   int64_t cpu_delta_available = 0;
+   process_powerup_queue(now, core_symbol, state, orders, 2, net_delta_available, cpu_delta_available, true);
+
+   eosio::asset fee{ 0, core_symbol };
+   int64_t      net_amount = reserve_powerup(net_frac, state.net, fee);
+   int64_t      cpu_amount = reserve_powerup(cpu_frac, state.cpu, fee);
+   eosio::check(fee >= state.min_powerup_fee, "calculated fee is below minimum; try powering up with more resources");
+
+   return action_return_powerup{ fee, net_amount, cpu_amount };
+}
+
+void system_contract::subpowerup(const name& owner, const name& receiver, int64_t net_frac, int64_t cpu_frac,
+                                 const asset& max_fee, const asset& deposit) {
+   require_auth(owner);
+   auto core_symbol = get_core_symbol();
+   eosio::check(eosio::is_account(receiver), "receiver account does not exist");
+   check_powerup_fracs(net_frac, cpu_frac);
+   eosio::check(net_frac > 0 || cpu_frac > 0, "must subscribe to some net or cpu");
+   eosio::check(max_fee.symbol == core_symbol, "max_fee doesn't match core symbol");
+   eosio::check(max_fee.amount > 0, "max_fee must be positive");
+   eosio::check(deposit.symbol == core_symbol, "deposit doesn't match core symbol");
+   eosio::check(deposit.amount >= 0, "deposit can't be negative");
+   powerup_state_singleton state_sing{ get_self(), 0 };
+   eosio::check(state_sing.exists(), "powerup hasn't been initialized");
+   eosio::check(max_fee >= state_sing.get().min_powerup_fee, "max_fee is below the minimum powerup fee");
+
+   powerup_subscription_table subs{ get_self(), 0 };
+   auto                       idx = subs.get_index<"byowner"_n>();
+   auto                       it  = idx.find(powerup_subscription::owner_key(owner, receiver));
+   if (it == idx.end()) {
+      subs.emplace(owner, [&](auto& sub) {
+         sub.id       = subs.available_primary_key();
+         sub.owner    = owner;
+         sub.receiver = receiver;
+         sub.net_frac = net_frac;
+         sub.cpu_frac = cpu_frac;
+         sub.max_fee  = max_fee;
+         sub.balance  = deposit;
+         sub.next_run = eosio::current_time_point();
+      });
+   } else {
+      idx.modify(it, same_payer, [&](auto& sub) {
+         sub.net_frac = net_frac;
+         sub.cpu_frac = cpu_frac;
+         sub.max_fee  = max_fee;
+         sub.balance += deposit;
+         if (sub.next_run.utc_seconds == powerup_subscription::parked)
+            sub.next_run = eosio::current_time_point();
+      });
+   }
+
+   if (deposit.amount > 0) {
+      add_powerup_escrow(deposit);
+      token::transfer_action transfer_act{ token_account, { owner, active_permission } };
+      transfer_act.send( owner, reserve_account, deposit,
+                               std::string("powerup subscription for ") + receiver.to_string() );
+   }
+}
+
+void system_contract::unsubpowerup(const name& owner, const name& receiver) {
+   require_auth(owner);
+   powerup_subscription_table subs{ get_self(), 0 };
+   auto                       idx = subs.get_index<"byowner"_n>();
+   auto                       it  = idx.find(powerup_subscription::owner_key(owner, receiver));
+   eosio::check(it != idx.end(), "subscription not found");
+
+   if (it->balance.amount > 0) {
+      add_powerup_escrow(-it->balance);
+      token::transfer_action transfer_act{ token_account, { reserve_account, active_permission } };
+      transfer_act.send( reserve_account, owner, it->balance,
+                               std::string("powerup subscription refund for ") + receiver.to_string() );
+   }
+   idx.erase(it);
+}
+
+void system_contract::runsubs(uint16_t max) {
+   powerup_state_singleton state_sing{ get_self(), 0 };
+   powerup_order_table     orders{ get_self(), 0 };
+   eosio::check(state_sing.exists(), "powerup hasn't been initialized");
+   auto           state       = state_sing.get();
+   time_point_sec now         = eosio::current_time_point();
+   auto           core_symbol = get_core_symbol();
+
+   int64_t net_delta_available = 0;
+   int64_t cpu_delta_available = 0;
+   process_powerup_queue(now, core_symbol, state, orders, 2, net_delta_available, cpu_delta_available);
+
+   powerup_subscription_table subs{ get_self(), 0 };
+   auto                       idx = subs.get_index<"bynextrun"_n>();
+   eosio::asset               total_fee{ 0, core_symbol };
+   // a processed subscription moves past `now` in the index, so the next due one is always first
+   for (auto it = idx.begin(); max && it != idx.end() && it->next_run <= now; --max, it = idx.begin()) {
+      // a balance below the minimum fee can't pay a renewal, park the subscription until it is topped up;
+      // its owner claims the balance with `unsubpowerup`, a transfer here could be rejected and stall the batch
+      if (it->balance < state.min_powerup_fee) {
+         idx.modify(it, same_payer, [&](auto& sub) { sub.next_run = time_point_sec(powerup_subscription::parked); });
+         continue;
+      }
+
+      powerup_state_resource net = state.net;
+      powerup_state_resource cpu = state.cpu;
+      eosio::asset           fee{ 0, core_symbol };
+      int64_t                net_amount, cpu_amount;
+      bool renewed = !try_reserve_powerup(it->net_frac, net, fee, net_amount) &&
+                     !try_reserve_powerup(it->cpu_frac, cpu, fee, cpu_amount) &&
+                     fee >= state.min_powerup_fee && fee <= it->max_fee && fee <= it->balance;
+
+      time_point_sec next_run = now + powerup_subscription::retry_secs;
+      if (renewed) {
+         state.net = net;
+         state.cpu = cpu;
+         next_run = queue_powerup_order(get_self(), it->receiver, net_amount, cpu_amount,
+                                        now + eosio::days(state.powerup_days));
+         net_delta_available -= net_amount;
+         cpu_delta_available -= cpu_amount;
+         adjust_resources(get_self(), it->receiver, core_symbol, net_amount, cpu_amount, true);
+         total_fee += fee;
+      }
+      idx.modify(it, same_payer, [&](auto& sub) {
+         if (renewed)
+            sub.balance -= fee;
+         sub.next_run = next_run;
+      });
+   }
+
+   adjust_reserve(state, now, core_symbol, net_delta_available, cpu_delta_available, false);
+   if (total_fee.amount > 0) {
+      add_powerup_escrow(-total_fee);
+      token::transfer_action transfer_act{ token_account, { reserve_account, active_permission } };
+      transfer_act.send( reserve_account, fees_account, total_fee, std::string("powerup subscription fees") );
+   }
+   state_sing.set(state, get_self());
+}
+
+void system_contract::add_powerup_escrow(const asset& delta) {
+   powerup_escrow_singleton escrow_sing{ get_self(), 0 };
+   auto escrow = escrow_sing.get_or_default(powerup_escrow{ asset{ 0, delta.symbol } });
+   escrow.balance += delta;
+   eosio::check(escrow.balance.amount >= 0, "powerup escrow can't be negative");
+   escrow_sing.set(escrow, get_self());
+}
+
+void system_contract::cfgpowupres(bool enabled) {
+   require_auth(get_self());
+   _gstate4.powupresult_disabled = !enabled;
+}
+
+void system_contract::cfgpowupmrg(bool enabled) {
+   require_auth(get_self());
+   _gstate4.powerup_merge_orders = enabled;
 }
 
 } // namespace eosiosystem
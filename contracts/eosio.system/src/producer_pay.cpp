@@ -54,19 +54,21 @@ namespace eosiosystem {
          update_elected_producers( timestamp );
 
          if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
-            name_bid_table bids(get_self(), get_self().value);
-            auto idx = bids.get_index<"highbid"_n>();
-            auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
-            if( highest != idx.end() &&
-                highest->high_bid > 0 &&
-                (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
+            if( !_gstate4.name_candidate_valid ) {
+               refresh_name_candidate();
+            }
+            if( _gstate4.name_candidate_bid > 0 &&
+                (current_time_point() - _gstate4.name_candidate_bid_time) > microseconds(useconds_per_day) &&
                 _gstate.thresh_activated_stake_time > time_point() &&
                 (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
                _gstate.last_name_close = timestamp;
-               idx.modify( highest, same_payer, [&]( auto& b ){
+               name_bid_table bids(get_self(), get_self().value);
+               bids.modify( bids.get( _gstate4.name_candidate.value ), same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
+                  b.last_bid_time = current_time_point(); // the close time, `prunebids` counts its grace period from it
                });
+               refresh_name_candidate();
             }
          }
       }
@@ -122,7 +124,7 @@ namespace eosiosystem {
    }
 
    // as_gbm is deprecated and maintained only for backwards compatibility with existing actions
-   void system_contract::claim_producer_rewards( const name owner, bool as_gbm ) {
+   int64_t system_contract::claim_producer_rewards( const name owner, bool as_gbm ) {
       require_auth( owner );
 
       const auto& prod = _producers.get( owner.value );
@@ -185,14 +187,16 @@ namespace eosiosystem {
         token::transfer_action transfer_act{ token_account, { {bpay_account, active_permission}, {owner, active_permission} } };
         transfer_act.send( bpay_account, owner, asset(producer_per_block_pay, core_symbol()), "producer block pay" );
       }
+
+      return producer_per_block_pay;
    }
 
-   void system_contract::claimrewards( const name& owner ) {
-      claim_producer_rewards(owner, false);
+   action_return_claimrewards system_contract::claimrewards( const name& owner ) {
+      return action_return_claimrewards{ owner, asset(claim_producer_rewards(owner, false), core_symbol()) };
    }
 
-   void system_contract::claimgbmprod( const name owner ) {
-      claim_producer_rewards(owner, true);
+   action_return_claimrewards system_contract::claimgbmprod( const name owner ) {
+      return action_return_claimrewards{ owner, asset(claim_producer_rewards(owner, true), core_symbol()) };
    }
 
 } //namespace eosiosystem
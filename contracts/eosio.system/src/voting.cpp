@@ -353,16 +353,18 @@ namespace eosiosystem {
       }
    }
 
-   void system_contract::voterclaim(const name owner) {
+   action_return_voterclaim system_contract::voterclaim(const name owner) {
       int64_t reward = collect_voter_reward(owner);
 
       eosio::token::transfer_action transfer_act{ token_account, { {voters_account, active_permission}, {owner, active_permission} } };
       transfer_act.send( voters_account, owner, asset(reward, core_symbol()), "voter pay" );
+
+      return action_return_voterclaim{ owner, asset(reward, core_symbol()) };
    }
 
-   void system_contract::claimgbmvote(const name owner) {
+   action_return_voterclaim system_contract::claimgbmvote(const name owner) {
       // gbm is expired, this action does a regular voterclaim now
-      voterclaim(owner);
+      return voterclaim(owner);
    }
 
    int64_t system_contract::collect_voter_reward(const name owner) {
@@ -9,6 +9,7 @@
 #include <eosio.system/eosio.system.hpp>
 #include <eosio.token/eosio.token.hpp>
 
+#include <algorithm>
 #include <cmath>
 
 namespace eosiosystem {
@@ -144,18 +145,20 @@ namespace eosiosystem {
 
         time_point_sec current_time = current_time_point();
         auto& proposal = (*itr_proposal);
+        auto itr_tally = get_proposal_tally(proposal);
+        auto& tally = (*itr_tally);
 
-        check(proposal.status == PROPOSAL_STATUS::APPROVED, "Proposal::status is not PROPOSAL_STATUS::APPROVED");
-        check(proposal.iteration_of_funding <= proposal.total_iterations, "all funds for this proposal have already been claimed");
+        check(tally.status == PROPOSAL_STATUS::APPROVED, "Proposal::status is not PROPOSAL_STATUS::APPROVED");
+        check(tally.iteration_of_funding <= tally.total_iterations, "all funds for this proposal have already been claimed");
 
         uint32_t funding_duration_seconds = proposal.duration * seconds_per_day;
-        uint32_t seconds_per_claim_interval = funding_duration_seconds / proposal.total_iterations;
-        time_point_sec start_funding_round = proposal.fund_start_time +
-                (uint32_t) (proposal.iteration_of_funding * seconds_per_claim_interval);
+        uint32_t seconds_per_claim_interval = funding_duration_seconds / tally.total_iterations;
+        time_point_sec start_funding_round = tally.fund_start_time +
+                (uint32_t) (tally.iteration_of_funding * seconds_per_claim_interval);
 
         check(current_time > start_funding_round, "Please wait until the end of this interval to claim funding");
 
-        asset transfer_amount = proposal.funding_goal / proposal.total_iterations;
+        asset transfer_amount = proposal.funding_goal / tally.total_iterations;
 
         //inline action transfer, send funds to proposer
         eosio::action(
@@ -168,17 +171,15 @@ namespace eosiosystem {
             _proposer.last_claim_time = current_time;
         });
 
-        uint32_t past_iteration = proposal.iteration_of_funding;
+        uint32_t past_iteration = tally.iteration_of_funding;
 
-        _proposals.modify(itr_proposal, same_payer, [&](auto& _proposal){
-            _proposal.iteration_of_funding += 1;
+        _proptally.modify(itr_tally, same_payer, [&](auto& _tally){
+            _tally.iteration_of_funding += 1;
+            if(past_iteration >= _tally.total_iterations){
+                _tally.status = PROPOSAL_STATUS::COMPLETED;
+            }
         });
-
-        if(past_iteration >= proposal.total_iterations){
-            _proposals.modify(itr_proposal, same_payer, [&](auto& _proposal){
-                _proposal.status = PROPOSAL_STATUS::COMPLETED;
-            });
-        }
+        mirror_proposal_tally(itr_proposal, tally);
         //change state based on count
     }
 
@@ -265,6 +266,14 @@ namespace eosiosystem {
             proposal.iteration_of_funding = 1;
             proposal.total_iterations = total_iterations;
         });
+
+        _proptally.emplace(proposer, [&](auto& tally) {
+            tally.proposer = proposer;
+            tally.status = PROPOSAL_STATUS::PENDING;
+            tally.total_votes = 0;
+            tally.iteration_of_funding = 1;
+            tally.total_iterations = total_iterations;
+        });
     }
 
     void system_contract::editproposal(
@@ -321,7 +330,8 @@ namespace eosiosystem {
         // verify that the account already exists in the proposals table
         check(proposal_itr != _proposals.end(), "Account not found in proposal table");
 
-        check((*proposal_itr).status == PROPOSAL_STATUS::PENDING, "Proposal::status is not PROPOSAL_STATUS::PENDING");
+        auto tally_itr = get_proposal_tally(*proposal_itr);
+        check((*tally_itr).status == PROPOSAL_STATUS::PENDING, "Proposal::status is not PROPOSAL_STATUS::PENDING");
 
         auto committee_itr = _committees.find(committee.value);
         // verify that the committee is on committee table
@@ -343,6 +353,10 @@ namespace eosiosystem {
             proposal.funding_goal = funding_goal;
             proposal.total_iterations = total_iterations;
         });
+
+        _proptally.modify(tally_itr, same_payer, [&](auto& tally){
+            tally.total_iterations = total_iterations;
+        });
     }
 
     void system_contract::regreviewer(name committee, name reviewer, const string& first_name, const string& last_name){
@@ -441,13 +455,15 @@ namespace eosiosystem {
 
         auto itr_proposal = _proposals.find(proposer.value);
         check(itr_proposal != _proposals.end(), "Proposal not found in proposal table");
-        check((*itr_proposal).status == PROPOSAL_STATUS::PENDING, "Proposal::status is not proposal_status::PENDING");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check((*itr_tally).status == PROPOSAL_STATUS::PENDING, "Proposal::status is not proposal_status::PENDING");
         check((*itr_proposal).committee == (*itr).committee, "Reviewer is not part of this proposal's responsible committee");
 
-        _proposals.modify(itr_proposal, same_payer, [&](auto& proposal){
-            proposal.vote_start_time = current_time_point();
-            proposal.status = PROPOSAL_STATUS::ON_VOTE;
+        _proptally.modify(itr_tally, same_payer, [&](auto& tally){
+            tally.vote_start_time = current_time_point();
+            tally.status = PROPOSAL_STATUS::ON_VOTE;
         });
+        mirror_proposal_tally(itr_proposal, *itr_tally);
     }
 
     void system_contract::rejectprop(name reviewer, name proposer, const string& reason){
@@ -464,12 +480,14 @@ namespace eosiosystem {
         auto itr_proposal = _proposals.find(proposer.value);
         check(itr_proposal != _proposals.end(), "Proposal not found in proposal table");
         check((*itr_proposal).committee == (*itr).committee, "Reviewer is not part of this proposal's responsible committee");
-        check(((*itr_proposal).status == PROPOSAL_STATUS::PENDING) || ((*itr_proposal).status == PROPOSAL_STATUS::ON_VOTE)
-                || ((*itr_proposal).status == PROPOSAL_STATUS::FINISHED_VOTING), "invalid proposal status");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check(((*itr_tally).status == PROPOSAL_STATUS::PENDING) || ((*itr_tally).status == PROPOSAL_STATUS::ON_VOTE)
+                || ((*itr_tally).status == PROPOSAL_STATUS::FINISHED_VOTING), "invalid proposal status");
 
-        _proposals.modify(itr_proposal, (*itr_proposal).proposer, [&](auto& proposal){
-            proposal.status = PROPOSAL_STATUS::REJECTED;
+        _proptally.modify(itr_tally, same_payer, [&](auto& tally){
+            tally.status = PROPOSAL_STATUS::REJECTED;
         });
+        mirror_proposal_tally(itr_proposal, *itr_tally);
     }
 
     void system_contract::approve(name reviewer, name proposer){
@@ -483,15 +501,17 @@ namespace eosiosystem {
         auto itr_proposal = _proposals.find(proposer.value);
         check(itr_proposal != _proposals.end(), "Proposal not found in proposal table");
         check((*itr_proposal).committee==(*itr).committee, "Reviewer is not part of this proposal's responsible committee");
-        check((*itr_proposal).status == PROPOSAL_STATUS::FINISHED_VOTING, "Proposal::status is not PROPOSAL_STATUS::FINISHED_VOTING");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check((*itr_tally).status == PROPOSAL_STATUS::FINISHED_VOTING, "Proposal::status is not PROPOSAL_STATUS::FINISHED_VOTING");
 
-        _proposals.modify(itr_proposal, same_payer, [&](auto& proposal){
-            proposal.fund_start_time = current_time_point();
-            proposal.status = PROPOSAL_STATUS::APPROVED;
+        _proptally.modify(itr_tally, same_payer, [&](auto& tally){
+            tally.fund_start_time = current_time_point();
+            tally.status = PROPOSAL_STATUS::APPROVED;
         });
+        mirror_proposal_tally(itr_proposal, *itr_tally);
     }
 
-    void system_contract::rmvreject(name reviewer, name proposer){
+    bool system_contract::rmvreject(name reviewer, name proposer){
         require_auth(reviewer);
 
         check(is_account(proposer), "Proposal creator does not exist");
@@ -501,13 +521,19 @@ namespace eosiosystem {
 
         auto itr_proposal = _proposals.find(proposer.value);
         check(itr_proposal != _proposals.end(), "Proposal not found in rejected proposal table");
-        check((*itr_proposal).status == PROPOSAL_STATUS::REJECTED, "Proposal::status is not PROPOSAL_STATUS::REJECTED");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check((*itr_tally).status == PROPOSAL_STATUS::REJECTED, "Proposal::status is not PROPOSAL_STATUS::REJECTED");
         check((*itr_proposal).committee==(*itr).committee, "Reviewer is not part of this proposal's responsible committee");
 
+        if(!remove_proposal_votes(proposer, wps_votes_removed_per_action)){
+            return false;
+        }
+        _proptally.erase(itr_tally);
         _proposals.erase(itr_proposal);
+        return true;
     }
 
-    void system_contract::rmvcompleted(name reviewer, name proposer){
+    bool system_contract::rmvcompleted(name reviewer, name proposer){
         require_auth(reviewer);
 
         check(is_account(proposer), "Proposal creator does not exist");
@@ -517,13 +543,66 @@ namespace eosiosystem {
 
         auto itr_proposal = _proposals.find(proposer.value);
         check(itr_proposal != _proposals.end(), "Proposal not found in completed proposals table");
-        check((*itr_proposal).status == PROPOSAL_STATUS::COMPLETED, "Proposal::status is not PROPOSAL_STATUS::COMPLETED");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check((*itr_tally).status == PROPOSAL_STATUS::COMPLETED, "Proposal::status is not PROPOSAL_STATUS::COMPLETED");
         check((*itr_proposal).committee==(*itr).committee, "Reviewer is not part of this proposal's responsible committee");
 
+        if(!remove_proposal_votes(proposer, wps_votes_removed_per_action)){
+            return false;
+        }
+        _proptally.erase(itr_tally);
         _proposals.erase(itr_proposal);
+        return true;
     }
 
-    void system_contract::cleanvotes(name reviewer, name proposer, uint64_t begin, uint64_t end){
+    proposal_tally_table::const_iterator system_contract::get_proposal_tally(const proposal& prop){
+        auto itr = _proptally.find(prop.proposer.value);
+        if(itr != _proptally.end()){
+            return itr;
+        }
+        // proposals registered before the tallies were split off carry their tally in the proposal itself
+        return _proptally.emplace(get_self(), [&](auto& tally){
+            tally.proposer = prop.proposer;
+            tally.total_votes = prop.total_votes;
+            tally.status = prop.status;
+            tally.vote_start_time = prop.vote_start_time;
+            tally.fund_start_time = prop.fund_start_time;
+            tally.iteration_of_funding = prop.iteration_of_funding;
+            tally.total_iterations = prop.total_iterations;
+        });
+    }
+
+    void system_contract::mirror_proposal_tally(proposal_table::const_iterator itr_proposal, const proposal_tally& tally){
+        _proposals.modify(itr_proposal, same_payer, [&](auto& proposal){
+            proposal.total_votes = tally.total_votes;
+            proposal.status = tally.status;
+            proposal.vote_start_time = tally.vote_start_time;
+            proposal.fund_start_time = tally.fund_start_time;
+            proposal.iteration_of_funding = tally.iteration_of_funding;
+            proposal.total_iterations = tally.total_iterations;
+        });
+    }
+
+    bool system_contract::remove_proposal_votes(const name& proposer, uint32_t max){
+        wps_proposal_voters_table propvoters(get_self(), proposer.value);
+        auto pv = propvoters.begin();
+        for (; pv != propvoters.end() && max > 0; --max){
+            auto wpsvoter = _wpsvoters.find(pv->voter.value);
+            if(wpsvoter != _wpsvoters.end()){
+                auto it = std::find(wpsvoter->proposals.begin(), wpsvoter->proposals.end(), proposer);
+                if(it != wpsvoter->proposals.end()){
+                    auto index = std::distance(wpsvoter->proposals.begin(), it);
+                    _wpsvoters.modify(wpsvoter, same_payer, [&](auto& wv){
+                        wv.proposals.erase(wv.proposals.begin() + index);
+                    });
+                }
+            }
+            pv = propvoters.erase(pv);
+        }
+        return pv == propvoters.end();
+    }
+
+    name system_contract::cleanvotes(name reviewer, name proposer, name cursor, uint16_t max){
         require_auth(reviewer);
 
         check(is_account(proposer), "Proposal creator does not exist");
@@ -531,28 +610,39 @@ namespace eosiosystem {
         auto itr = _reviewers.find(reviewer.value);
         check(itr != _reviewers.end(), "Account not found in reviewers table");
 
-        check(end > begin, "Invalid range");
-
-        for (auto wpsvoter = std::next(_wpsvoters.begin(), begin); wpsvoter != std::next(_wpsvoters.begin(), end); wpsvoter++){
-            std::vector<name> votes = wpsvoter->proposals;
-            auto it = votes.begin();
-            if(votes.begin() != votes.end()){
-                int count = 0;
-                while(it != votes.end()){
-                    if(*it == proposer){
-                        it = votes.erase(it);
-                        count++;
-                        break;
-                    }
-                    ++it;
+        check(max > 0, "max must be greater than 0");
+
+        auto wpsvoter = _wpsvoters.lower_bound(cursor.value);
+        for (; wpsvoter != _wpsvoters.end() && max > 0; ++wpsvoter, --max){
+            auto it = std::find(wpsvoter->proposals.begin(), wpsvoter->proposals.end(), proposer);
+            if(it != wpsvoter->proposals.end()){
+                auto index = std::distance(wpsvoter->proposals.begin(), it);
+                _wpsvoters.modify(wpsvoter, same_payer, [&](auto& wv){
+                    wv.proposals.erase(wv.proposals.begin() + index);
+                });
+            }
+        }
+        return wpsvoter != _wpsvoters.end() ? wpsvoter->owner : name();
+    }
+
+    name system_contract::fillpropvote(const name& cursor, uint16_t max){
+        check(max > 0, "max must be greater than 0");
+
+        auto wpsvoter = _wpsvoters.lower_bound(cursor.value);
+        for (; wpsvoter != _wpsvoters.end() && max > 0; ++wpsvoter, --max){
+            for( const auto& p : wpsvoter->proposals ) {
+                if( _proposals.find(p.value) == _proposals.end() ) {
+                    continue;
                 }
-                if(count != 0){
-                    _wpsvoters.modify(wpsvoter, same_payer, [&](auto& wv){
-                        wv.proposals = votes;
+                wps_proposal_voters_table propvoters(get_self(), p.value);
+                if( propvoters.find(wpsvoter->owner.value) == propvoters.end() ) {
+                    propvoters.emplace(get_self(), [&](auto& v){
+                        v.voter = wpsvoter->owner;
                     });
                 }
             }
         }
+        return wpsvoter != _wpsvoters.end() ? wpsvoter->owner : name();
     }
 
     void system_contract::setwpsenv(
@@ -658,17 +748,49 @@ namespace eosiosystem {
         check(itr_proposal != _proposals.end(), "Proposal not found in proposal table");
 
         check((*itr_proposal).committee == (*itr).committeeman || (*itr).is_oversight, "Committee is not associated with this proposal");
-        check((*itr_proposal).status == PROPOSAL_STATUS::APPROVED, "Proposal::status is not PROPOSAL_STATUS::APPROVED");
+        auto itr_tally = get_proposal_tally(*itr_proposal);
+        check((*itr_tally).status == PROPOSAL_STATUS::APPROVED, "Proposal::status is not PROPOSAL_STATUS::APPROVED");
 
-        _proposals.modify(itr_proposal, same_payer, [&](auto& _proposal){
-            _proposal.status = PROPOSAL_STATUS::REJECTED;
+        _proptally.modify(itr_tally, same_payer, [&](auto& _tally){
+            _tally.status = PROPOSAL_STATUS::REJECTED;
         });
+        mirror_proposal_tally(itr_proposal, *itr_tally);
     }
 
     void system_contract::voteproposal( const name& voter_name, const std::vector<name>& proposals ) {
         require_auth( voter_name );
         // vote_stake_updater( voter_name );
+        std::vector<name> old_proposals;
+        auto wpsvoter = _wpsvoters.find( voter_name.value );
+        if( wpsvoter != _wpsvoters.end() ) {
+            old_proposals = wpsvoter->proposals;
+        }
         update_wps_votes( voter_name, proposals );
+        update_proposal_voters( voter_name, old_proposals, proposals );
+    }
+
+    void system_contract::update_proposal_voters( const name& voter_name, const std::vector<name>& old_proposals,
+                                                  const std::vector<name>& proposals ){
+        for( const auto& p : old_proposals ) {
+            if( std::find(proposals.begin(), proposals.end(), p) == proposals.end() ) {
+                wps_proposal_voters_table propvoters(get_self(), p.value);
+                auto pv = propvoters.find(voter_name.value);
+                if( pv != propvoters.end() ) {
+                    propvoters.erase(pv);
+                }
+            }
+        }
+        for( const auto& p : proposals ) {
+            if( _proposals.find(p.value) == _proposals.end() ) {
+                continue;
+            }
+            wps_proposal_voters_table propvoters(get_self(), p.value);
+            if( propvoters.find(voter_name.value) == propvoters.end() ) {
+                propvoters.emplace(voter_name, [&](auto& v){
+                    v.voter = voter_name;
+                });
+            }
+        }
     }
 
     void system_contract::update_wps_votes( const name& voter_name, const std::vector<name>& proposals){
@@ -722,32 +844,34 @@ namespace eosiosystem {
         for( const auto& pd : proposal_deltas ) {
             auto pitr = _proposals.find( pd.first.value );
             if( pitr != _proposals.end() ) {
+                auto titr = get_proposal_tally( *pitr );
 
-                if((*pitr).status == PROPOSAL_STATUS::ON_VOTE){
+                if((*titr).status == PROPOSAL_STATUS::ON_VOTE){
                     time_point_sec current_time = current_time_point();
                     wps_env_singleton _wps_env(get_self(), get_self().value);
                     auto wps_env = _wps_env.get();
                     uint32_t duration_of_voting = wps_env.duration_of_voting * seconds_per_day;
 
-                    if(time_point_sec(time_point(current_time - (*pitr).vote_start_time)) >= time_point_sec(duration_of_voting)) {
-                        _proposals.modify(pitr, same_payer, [&](auto &proposal) {
-                            proposal.status = PROPOSAL_STATUS::REJECTED;
+                    if(time_point_sec(time_point(current_time - (*titr).vote_start_time)) >= time_point_sec(duration_of_voting)) {
+                        _proptally.modify(titr, same_payer, [&](auto &tally) {
+                            tally.status = PROPOSAL_STATUS::REJECTED;
                         });
+                        mirror_proposal_tally(pitr, *titr);
                     }
                     else{
-                        _proposals.modify( pitr, same_payer, [&]( auto& p ) {
-                            p.total_votes += pd.second.first;
-                            if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                                p.total_votes = 0;
-                            }
-                        });
                         double total_activated_vote = stake2vote(_wps_state.total_stake);
-                        if((*pitr).total_votes > total_activated_vote * double(wps_env.total_voting_percent)/100.0){
-                            if((*pitr).status == PROPOSAL_STATUS::ON_VOTE){
-                                _proposals.modify( pitr, same_payer, [&]( auto& p ) {
-                                    p.status = PROPOSAL_STATUS::FINISHED_VOTING;
-                                });
+                        _proptally.modify( titr, same_payer, [&]( auto& t ) {
+                            t.total_votes += pd.second.first;
+                            if ( t.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+                                t.total_votes = 0;
+                            }
+                            if( t.total_votes > total_activated_vote * double(wps_env.total_voting_percent)/100.0 ) {
+                                t.status = PROPOSAL_STATUS::FINISHED_VOTING;
                             }
+                        });
+                        // only the status change is mirrored, plain votes would rewrite the description every time
+                        if((*titr).status != PROPOSAL_STATUS::ON_VOTE){
+                            mirror_proposal_tally(pitr, *titr);
                         }
                     }
                 }
@@ -58,14 +58,22 @@ FC_REFLECT(powerup_state_resource,
            (initial_timestamp)(target_timestamp)(exponent)(decay_secs)(min_price)(max_price)(utilization)   //
            (adjusted_utilization)(utilization_timestamp))
 
+struct powerup_reserve_sync {
+   int64_t        net_delta;
+   int64_t        cpu_delta;
+   time_point_sec last_sync;
+};
+FC_REFLECT(powerup_reserve_sync, (net_delta)(cpu_delta)(last_sync))
+
 struct powerup_state {
    uint8_t               version;
    powerup_state_resource net;
    powerup_state_resource cpu;
    uint32_t              powerup_days;
    asset                 min_powerup_fee;
+   powerup_reserve_sync  reserve_sync;
 };
-FC_REFLECT(powerup_state, (version)(net)(cpu)(powerup_days)(min_powerup_fee))
+FC_REFLECT(powerup_state, (version)(net)(cpu)(powerup_days)(min_powerup_fee)(reserve_sync))
 
 using namespace eosio_system;
 
@@ -106,6 +114,30 @@ struct powerup_tester : eosio_system_tester {
       return make_config([](auto&) {});
    }
 
+   // A market of `stake_weight` net and cpu at a fixed price, 1% of either costs 10000.0000 TST
+   template <typename F>
+   powerup_config make_fixed_price_config(F f) {
+      return make_config([&](auto& config) {
+         config.net.current_weight_ratio = powerup_frac / 2;
+         config.net.target_weight_ratio  = powerup_frac / 2;
+         config.net.exponent             = 1;
+         config.net.min_price            = asset::from_string("1000000.0000 TST");
+         config.net.max_price            = asset::from_string("1000000.0000 TST");
+
+         config.cpu.current_weight_ratio = powerup_frac / 2;
+         config.cpu.target_weight_ratio  = powerup_frac / 2;
+         config.cpu.exponent             = 1;
+         config.cpu.min_price            = asset::from_string("1000000.0000 TST");
+         config.cpu.max_price            = asset::from_string("1000000.0000 TST");
+
+         f(config);
+      });
+   }
+
+   powerup_config make_fixed_price_config() {
+      return make_fixed_price_config([](auto&) {});
+   }
+
    template <typename F>
    powerup_config make_default_config(F f) {
       powerup_config config;
@@ -162,6 +194,13 @@ struct powerup_tester : eosio_system_tester {
       return fc::raw::unpack<powerup_state>(data);
    }
 
+   fc::variant get_bucket(uint32_t day) {
+      vector<char> data = get_row_by_account(config::system_account_name, {}, "powup.bucket"_n, account_name(day));
+      return data.empty() ? fc::variant()
+                          : abi_ser.binary_to_variant("powerup_bucket", data,
+                                                      abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
    struct account_info {
       int64_t ram = 0;
       int64_t net = 0;
@@ -222,8 +261,13 @@ struct powerup_tester : eosio_system_tester {
       BOOST_REQUIRE_EQUAL(before_payer.liquid - after_payer.liquid, expected_fee);
       BOOST_REQUIRE_EQUAL(after_fee_receiver.liquid - before_fee_receiver.liquid, expected_fee);
 
-      BOOST_REQUIRE_EQUAL(before_reserve.net - after_reserve.net, expected_net);
-      BOOST_REQUIRE_EQUAL(before_reserve.cpu - after_reserve.cpu, expected_cpu);
+      // the reserve's resources lag behind by the pending deltas
+      BOOST_REQUIRE_EQUAL((before_reserve.net + before_state.reserve_sync.net_delta) -
+                                (after_reserve.net + after_state.reserve_sync.net_delta),
+                          expected_net);
+      BOOST_REQUIRE_EQUAL((before_reserve.cpu + before_state.reserve_sync.cpu_delta) -
+                                (after_reserve.cpu + after_state.reserve_sync.cpu_delta),
+                          expected_cpu);
       BOOST_REQUIRE_EQUAL(after_state.net.utilization - before_state.net.utilization, expected_net);
       BOOST_REQUIRE_EQUAL(after_state.cpu.utilization - before_state.cpu.utilization, expected_cpu);
    }
@@ -834,4 +878,362 @@ BOOST_AUTO_TEST_CASE(rent_tests) try {
 } // rent_tests
 FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE(fractional_decay_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config([&](auto& config) {
+      config.net.decay_secs = 100000;
+      config.cpu.decay_secs = 7;
+   })));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("300000.0000"));
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 10, powerup_frac / 5,
+                                     asset::from_string("300000.0000 TST")));
+
+   // Start decay
+   t.produce_block(fc::days(30) - fc::milliseconds(500));
+   BOOST_REQUIRE_EQUAL("", t.powerupexec(config::system_account_name, 10));
+   BOOST_REQUIRE(near(t.get_state().net.adjusted_utilization, .1 * stake_weight, 0));
+   BOOST_REQUIRE(near(t.get_state().cpu.adjusted_utilization, .2 * stake_weight, 0));
+
+   // the fixed-point decay stays within a unit of the floating-point one, for exponents with a fractional part
+   // (86400 / 100000) and large integral parts (86400 / 7)
+   t.produce_block(fc::days(1) - fc::milliseconds(500));
+   BOOST_REQUIRE_EQUAL("", t.powerupexec(config::system_account_name, 10));
+   BOOST_REQUIRE(near(t.get_state().net.adjusted_utilization, int64_t(.1 * stake_weight * exp(-86400. / 100000)), 1));
+   BOOST_REQUIRE_EQUAL(0, t.get_state().cpu.adjusted_utilization);
+} // fractional_decay_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(expiry_bucket_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("80000.0000"));
+
+   // both orders expire on the same day and share its bucket
+   const uint32_t day = (t.control->pending_block_time() + fc::days(30)).sec_since_epoch() / (24 * 3600);
+   BOOST_REQUIRE(t.get_bucket(day).is_null());
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "carol1111111"_n, 30, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+   auto bucket = t.get_bucket(day);
+   BOOST_REQUIRE_EQUAL(2, bucket["orders"].as<uint32_t>());
+
+   // retiring the orders one at a time empties the bucket, then removes it
+   t.produce_block(fc::days(31));
+   BOOST_REQUIRE_EQUAL("", t.powerupexec("alice1111111"_n, 1));
+   BOOST_REQUIRE_EQUAL(1, t.get_bucket(day)["orders"].as<uint32_t>());
+   BOOST_REQUIRE_EQUAL("", t.powerupexec("alice1111111"_n, 1));
+   BOOST_REQUIRE(t.get_bucket(day).is_null());
+   BOOST_REQUIRE_EQUAL(0, t.get_state().net.utilization);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().cpu.utilization);
+} // expiry_bucket_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(expiry_order_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("40000.0000"));
+
+   // keep both orders clear of the day boundary
+   t.produce_block(fc::hours(2));
+   const uint32_t day = (t.control->pending_block_time() + fc::days(30)).sec_since_epoch() / (24 * 3600);
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+
+   // a shorter powerup placed later expires first, but sits after the first one in the bucket
+   t.produce_block(fc::hours(23));
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_default_config([&](auto& config) { config.powerup_days = 29; })));
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "carol1111111"_n, 29, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+   BOOST_REQUIRE_EQUAL(2, t.get_bucket(day)["orders"].as<uint32_t>());
+
+   t.produce_block(fc::days(29));
+   BOOST_REQUIRE_EQUAL("", t.powerupexec("alice1111111"_n, 10));
+   BOOST_REQUIRE_EQUAL(1, t.get_bucket(day)["orders"].as<uint32_t>());
+   BOOST_REQUIRE_EQUAL(stake_weight / 100, t.get_state().net.utilization);
+   BOOST_REQUIRE_EQUAL(stake_weight / 100, t.get_state().cpu.utilization);
+} // expiry_order_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(merged_order_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("80000.0000"));
+
+   BOOST_REQUIRE_EQUAL("missing authority of eosio",
+                       t.push_action("alice1111111"_n, "cfgpowupmrg"_n, mvo()("enabled", true)));
+   BOOST_REQUIRE_EQUAL("", t.push_action(config::system_account_name, "cfgpowupmrg"_n, mvo()("enabled", true)));
+
+   // the expiry is rounded up to the next day boundary, both orders of alice are merged into one
+   const uint32_t seconds_per_day = 24 * 3600;
+   const uint32_t day = ((t.control->pending_block_time() + fc::days(30)).sec_since_epoch() + seconds_per_day - 1) / seconds_per_day;
+   auto before = t.get_account_info("alice1111111"_n);
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+   t.produce_block();
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 100, powerup_frac / 100,
+                                     asset::from_string("20000.0000 TST")));
+   auto bucket = t.get_bucket(day);
+   BOOST_REQUIRE_EQUAL(1, bucket["orders"].as<uint32_t>());
+
+   t.produce_block(fc::days(31));
+   BOOST_REQUIRE_EQUAL("", t.powerupexec("alice1111111"_n, 1));
+   BOOST_REQUIRE(t.get_bucket(day).is_null());
+   BOOST_REQUIRE_EQUAL(0, t.get_state().net.utilization);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().cpu.utilization);
+   auto after = t.get_account_info("alice1111111"_n);
+   BOOST_REQUIRE_EQUAL(before.net, after.net);
+   BOOST_REQUIRE_EQUAL(before.cpu, after.cpu);
+} // merged_order_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(powerupmany_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("50000.0000"));
+
+   auto requests = vector<fc::variant>{
+      mvo()("receiver", "alice1111111")("net_frac", powerup_frac / 100)("cpu_frac", powerup_frac / 100),
+      mvo()("receiver", "carol1111111")("net_frac", 0)("cpu_frac", powerup_frac / 50),
+   };
+   auto powerupmany = [&](const asset& max_payment) {
+      return t.push_action("bob111111111"_n, "powerupmany"_n,
+                           mvo()("payer", "bob111111111")("requests", requests)("max_payment", max_payment));
+   };
+
+   BOOST_REQUIRE_EQUAL(t.wasm_assert_msg("requests cannot be empty"),
+                       t.push_action("bob111111111"_n, "powerupmany"_n,
+                                     mvo()("payer", "bob111111111")("requests", vector<fc::variant>{})
+                                          ("max_payment", asset::from_string("40000.0000 TST"))));
+   BOOST_REQUIRE_EQUAL(t.wasm_assert_msg("max_payment is less than calculated fee: 40000.0000 TST"),
+                       powerupmany(asset::from_string("39999.9999 TST")));
+
+   // 1% + 1% for alice, 2% of cpu for carol, of 1000000.0000 TST each
+   auto before_alice = t.get_account_info("alice1111111"_n);
+   auto before_carol = t.get_account_info("carol1111111"_n);
+   auto before_fees  = t.get_balance("eosio.fees"_n);
+   auto trace = t.base_tester::push_action(config::system_account_name, "powerupmany"_n, "bob111111111"_n,
+                                           mvo()("payer", "bob111111111")("requests", requests)
+                                                ("max_payment", asset::from_string("40000.0000 TST")));
+   auto results = t.abi_ser.binary_to_variant("action_return_powerup[]", trace->action_traces[0].return_value,
+                                              abi_serializer::create_yield_function(abi_serializer_max_time)).get_array();
+   BOOST_REQUIRE_EQUAL(2, results.size());
+   BOOST_REQUIRE_EQUAL(asset::from_string("20000.0000 TST"), results[0]["fee"].as<asset>());
+   BOOST_REQUIRE_EQUAL(asset::from_string("20000.0000 TST"), results[1]["fee"].as<asset>());
+   BOOST_REQUIRE_EQUAL(0, results[1]["powup_net_weight"].as<int64_t>());
+
+   auto after_alice = t.get_account_info("alice1111111"_n);
+   auto after_carol = t.get_account_info("carol1111111"_n);
+   BOOST_REQUIRE_EQUAL(after_alice.net - before_alice.net, results[0]["powup_net_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(after_alice.cpu - before_alice.cpu, results[0]["powup_cpu_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(after_carol.net, before_carol.net);
+   BOOST_REQUIRE_EQUAL(after_carol.cpu - before_carol.cpu, results[1]["powup_cpu_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(t.get_state().net.utilization, results[0]["powup_net_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(t.get_state().cpu.utilization, results[0]["powup_cpu_weight"].as<int64_t>() +
+                                                      results[1]["powup_cpu_weight"].as<int64_t>());
+
+   // a single fee transfer and no powupresult
+   BOOST_REQUIRE_EQUAL(asset::from_string("40000.0000 TST"), t.get_balance("eosio.fees"_n) - before_fees);
+   BOOST_REQUIRE_EQUAL(1, std::count_if(trace->action_traces.begin(), trace->action_traces.end(), [](const auto& at) {
+                          return at.act.name == "transfer"_n && at.receiver == "eosio.token"_n;
+                       }));
+   BOOST_REQUIRE_EQUAL(0, std::count_if(trace->action_traces.begin(), trace->action_traces.end(), [](const auto& at) {
+                          return at.act.name == "powupresult"_n;
+                       }));
+} // powerupmany_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(reserve_sync_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("10000.0000"));
+   t.produce_block();
+   const auto synced = t.get_account_info("eosio.reserv"_n);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().reserve_sync.net_delta);
+
+   // 0.01% of each market is below 1/1000 of its weight, the reserve is not touched
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 10000, powerup_frac / 10000,
+                                     asset::from_string("200.0000 TST")));
+   BOOST_REQUIRE_EQUAL(synced.net, t.get_account_info("eosio.reserv"_n).net);
+   BOOST_REQUIRE_EQUAL(synced.cpu, t.get_account_info("eosio.reserv"_n).cpu);
+   BOOST_REQUIRE_EQUAL(-stake_weight / 10000, t.get_state().reserve_sync.net_delta);
+   BOOST_REQUIRE_EQUAL(-stake_weight / 10000, t.get_state().reserve_sync.cpu_delta);
+
+   // an hour later, the pending deltas are applied
+   t.produce_block(fc::hours(1));
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "carol1111111"_n, 30, powerup_frac / 10000, powerup_frac / 10000,
+                                     asset::from_string("200.0000 TST")));
+   BOOST_REQUIRE_EQUAL(synced.net - 2 * stake_weight / 10000, t.get_account_info("eosio.reserv"_n).net);
+   BOOST_REQUIRE_EQUAL(synced.cpu - 2 * stake_weight / 10000, t.get_account_info("eosio.reserv"_n).cpu);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().reserve_sync.net_delta);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().reserve_sync.cpu_delta);
+
+   // cfgpowerup always applies them
+   t.produce_block();
+   BOOST_REQUIRE_EQUAL("", t.powerup("bob111111111"_n, "alice1111111"_n, 30, powerup_frac / 10000, 0,
+                                     asset::from_string("100.0000 TST")));
+   BOOST_REQUIRE_EQUAL(-stake_weight / 10000, t.get_state().reserve_sync.net_delta);
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_default_config([](auto&) {})));
+   BOOST_REQUIRE_EQUAL(synced.net - 3 * stake_weight / 10000, t.get_account_info("eosio.reserv"_n).net);
+   BOOST_REQUIRE_EQUAL(0, t.get_state().reserve_sync.net_delta);
+} // reserve_sync_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(subscription_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("50000.0000"));
+   const auto bob_balance = t.get_balance("bob111111111"_n);
+
+   auto subpowerup = [&](name owner, const asset& max_fee, const asset& deposit) {
+      return t.push_action(owner, "subpowerup"_n,
+                           mvo()("owner", owner)("receiver", "alice1111111")("net_frac", powerup_frac / 100)
+                                ("cpu_frac", powerup_frac / 100)("max_fee", max_fee)("deposit", deposit));
+   };
+   auto runsubs = [&]() { return t.push_action("carol1111111"_n, "runsubs"_n, mvo()("max", 10)); };
+   auto get_subscription = [&](uint64_t id) {
+      vector<char> data = t.get_row_by_account(config::system_account_name, {}, "powup.subs"_n, name(id));
+      return data.empty() ? fc::variant()
+                          : t.abi_ser.binary_to_variant("powerup_subscription", data,
+                                                        abi_serializer::create_yield_function(abi_serializer_max_time));
+   };
+   auto get_escrow = [&]() {
+      vector<char> data = t.get_row_by_account(config::system_account_name, {}, "powup.escrow"_n, "powup.escrow"_n);
+      return data.empty() ? asset::from_string("0.0000 TST")
+                          : t.abi_ser.binary_to_variant("powerup_escrow", data,
+                                                        abi_serializer::create_yield_function(abi_serializer_max_time))["balance"].as<asset>();
+   };
+
+   BOOST_REQUIRE_EQUAL(t.wasm_assert_msg("max_fee must be positive"),
+                       subpowerup("bob111111111"_n, asset::from_string("0.0000 TST"), asset::from_string("0.0000 TST")));
+   BOOST_REQUIRE_EQUAL(t.wasm_assert_msg("max_fee is below the minimum powerup fee"),
+                       subpowerup("bob111111111"_n, asset::from_string("0.5000 TST"), asset::from_string("0.0000 TST")));
+   BOOST_REQUIRE_EQUAL("", subpowerup("bob111111111"_n, asset::from_string("20000.0000 TST"),
+                                      asset::from_string("50000.0000 TST")));
+   BOOST_REQUIRE_EQUAL(bob_balance - asset::from_string("50000.0000 TST"), t.get_balance("bob111111111"_n));
+   BOOST_REQUIRE_EQUAL(asset::from_string("50000.0000 TST"), get_escrow());
+
+   // another owner gets its own subscription for the same receiver, and can't touch bob's
+   BOOST_REQUIRE_EQUAL("", subpowerup("carol1111111"_n, asset::from_string("20000.0000 TST"), asset::from_string("0.0000 TST")));
+   BOOST_REQUIRE_EQUAL("carol1111111", get_subscription(1)["owner"].as_string());
+   BOOST_REQUIRE_EQUAL("", t.push_action("carol1111111"_n, "unsubpowerup"_n, mvo()("owner", "carol1111111")("receiver", "alice1111111")));
+   BOOST_REQUIRE(get_subscription(1).is_null());
+   BOOST_REQUIRE_EQUAL(asset::from_string("50000.0000 TST"), get_subscription(0)["balance"].as<asset>());
+
+   // the first renewal is due right away, 1% + 1% of 1000000.0000 TST each
+   auto before_alice = t.get_account_info("alice1111111"_n);
+   auto before_fees  = t.get_balance("eosio.fees"_n);
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   auto after_alice = t.get_account_info("alice1111111"_n);
+   BOOST_REQUIRE_EQUAL(stake_weight / 100, after_alice.net - before_alice.net);
+   BOOST_REQUIRE_EQUAL(stake_weight / 100, after_alice.cpu - before_alice.cpu);
+   BOOST_REQUIRE_EQUAL(asset::from_string("20000.0000 TST"), t.get_balance("eosio.fees"_n) - before_fees);
+   BOOST_REQUIRE_EQUAL(asset::from_string("30000.0000 TST"), get_subscription(0)["balance"].as<asset>());
+   BOOST_REQUIRE_EQUAL(asset::from_string("30000.0000 TST"), get_escrow());
+
+   // not due again until the powerup expires
+   t.produce_block();
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   BOOST_REQUIRE_EQUAL(asset::from_string("30000.0000 TST"), get_subscription(0)["balance"].as<asset>());
+   t.produce_block(fc::days(30));
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   BOOST_REQUIRE_EQUAL(asset::from_string("10000.0000 TST"), get_subscription(0)["balance"].as<asset>());
+   BOOST_REQUIRE_EQUAL(after_alice.net, t.get_account_info("alice1111111"_n).net);
+
+   // the balance no longer covers a renewal, it is retried later
+   t.produce_block(fc::days(30));
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   BOOST_REQUIRE_EQUAL(asset::from_string("10000.0000 TST"), get_subscription(0)["balance"].as<asset>());
+   BOOST_REQUIRE_EQUAL(before_alice.net, t.get_account_info("alice1111111"_n).net);
+
+   BOOST_REQUIRE_EQUAL(t.wasm_assert_msg("subscription not found"),
+                       t.push_action("carol1111111"_n, "unsubpowerup"_n, mvo()("owner", "carol1111111")("receiver", "alice1111111")));
+   BOOST_REQUIRE_EQUAL("", t.push_action("bob111111111"_n, "unsubpowerup"_n, mvo()("owner", "bob111111111")("receiver", "alice1111111")));
+   BOOST_REQUIRE_EQUAL(bob_balance - asset::from_string("40000.0000 TST"), t.get_balance("bob111111111"_n));
+   BOOST_REQUIRE(get_subscription(0).is_null());
+   BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 TST"), get_escrow());
+
+   // a balance below min_powerup_fee is parked instead of retried, the owner claims it back
+   t.transfer(config::system_account_name, "carol1111111"_n, core_sym::from_string("0.5000"));
+   const auto carol_balance = t.get_balance("carol1111111"_n);
+   BOOST_REQUIRE_EQUAL("", subpowerup("carol1111111"_n, asset::from_string("20000.0000 TST"), asset::from_string("0.5000 TST")));
+   BOOST_REQUIRE_EQUAL(carol_balance - asset::from_string("0.5000 TST"), t.get_balance("carol1111111"_n));
+   BOOST_REQUIRE_EQUAL(asset::from_string("0.5000 TST"), get_escrow());
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   BOOST_REQUIRE_EQUAL(carol_balance - asset::from_string("0.5000 TST"), t.get_balance("carol1111111"_n));
+   BOOST_REQUIRE_EQUAL(asset::from_string("0.5000 TST"), get_subscription(0)["balance"].as<asset>());
+   BOOST_REQUIRE_EQUAL(time_point_sec(std::numeric_limits<uint32_t>::max()),
+                       get_subscription(0)["next_run"].as<time_point_sec>());
+   t.produce_block(fc::days(30));
+   BOOST_REQUIRE_EQUAL("", runsubs());
+   BOOST_REQUIRE_EQUAL(asset::from_string("0.5000 TST"), get_subscription(0)["balance"].as<asset>());
+
+   BOOST_REQUIRE_EQUAL("", t.push_action("carol1111111"_n, "unsubpowerup"_n, mvo()("owner", "carol1111111")("receiver", "alice1111111")));
+   BOOST_REQUIRE_EQUAL(carol_balance, t.get_balance("carol1111111"_n));
+   BOOST_REQUIRE(get_subscription(0).is_null());
+   BOOST_REQUIRE_EQUAL(asset::from_string("0.0000 TST"), get_escrow());
+} // subscription_tests
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(powerup_result_tests) try {
+   powerup_tester t;
+   t.produce_block();
+
+   BOOST_REQUIRE_EQUAL("", t.configbw(t.make_fixed_price_config()));
+   t.transfer(config::system_account_name, "bob111111111"_n, core_sym::from_string("40000.0000"));
+
+   auto count_powupresult = [](const transaction_trace_ptr& trace) {
+      return std::count_if(trace->action_traces.begin(), trace->action_traces.end(),
+                           [](const auto& at) { return at.act.name == "powupresult"_n; });
+   };
+   auto do_powerup = [&]() {
+      return t.base_tester::push_action(config::system_account_name, "powerup"_n, "bob111111111"_n,
+                                        mvo()("payer", "bob111111111")("receiver", "alice1111111")("days", 30)
+                                             ("net_frac", powerup_frac / 100)("cpu_frac", powerup_frac / 100)
+                                             ("max_payment", asset::from_string("20000.0000 TST")));
+   };
+
+   auto quote_trace = t.base_tester::push_action(config::system_account_name, "quotepowerup"_n, "bob111111111"_n,
+                                                 mvo()("net_frac", powerup_frac / 100)("cpu_frac", powerup_frac / 100));
+   auto quote = t.abi_ser.binary_to_variant("action_return_powerup", quote_trace->action_traces[0].return_value,
+                                            abi_serializer::create_yield_function(abi_serializer_max_time));
+   BOOST_REQUIRE_EQUAL(0, t.get_state().net.utilization);
+
+   // 1%, 1% of 1000000.0000 TST each
+   auto trace = do_powerup();
+   BOOST_REQUIRE_EQUAL(1, count_powupresult(trace));
+   auto result = t.abi_ser.binary_to_variant("action_return_powerup", trace->action_traces[0].return_value,
+                                             abi_serializer::create_yield_function(abi_serializer_max_time));
+   BOOST_REQUIRE_EQUAL(quote["fee"].as<asset>(), result["fee"].as<asset>());
+   BOOST_REQUIRE_EQUAL(quote["powup_net_weight"].as<int64_t>(), result["powup_net_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(quote["powup_cpu_weight"].as<int64_t>(), result["powup_cpu_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(asset::from_string("20000.0000 TST"), result["fee"].as<asset>());
+   BOOST_REQUIRE_EQUAL(t.get_state().net.utilization, result["powup_net_weight"].as<int64_t>());
+   BOOST_REQUIRE_EQUAL(t.get_state().cpu.utilization, result["powup_cpu_weight"].as<int64_t>());
+
+   BOOST_REQUIRE_EQUAL("missing authority of eosio",
+                       t.push_action("alice1111111"_n, "cfgpowupres"_n, mvo()("enabled", false)));
+   BOOST_REQUIRE_EQUAL("", t.push_action(config::system_account_name, "cfgpowupres"_n, mvo()("enabled", false)));
+   t.produce_block();
+
+   trace = do_powerup();
+   BOOST_REQUIRE_EQUAL(0, count_powupresult(trace));
+   BOOST_REQUIRE(!trace->action_traces[0].return_value.empty());
+} // powerup_result_tests
+FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
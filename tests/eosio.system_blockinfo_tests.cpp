@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <limits>
 
@@ -33,6 +34,8 @@ struct block_info_record
 };
 
 static constexpr uint32_t rolling_window_size = 10;
+static constexpr uint8_t  slot_record_version = 1;
+static constexpr uint32_t hourly_batch_size   = 120;
 
 } // namespace
 
@@ -70,20 +73,21 @@ public:
    block_info_tester() : eosio_system_tester(eosio_system_tester::setup_level::deploy_contract) {}
 
    /**
-    * Scans filtered rows in blockinfo table in order of ascending block height where filtering only picks rows
-    * corresponding to block heights in the closed interval [start_block_height, end_block_height].
+    * Scans filtered rows in blockinfo table in order of ascending primary key where filtering only picks rows
+    * with primary keys in the closed interval [start_key, end_key]. The primary key of a row is the slot
+    * `block_height % rolling_window_size` of the rolling window.
     *
     * For each row visited, its deserialized block_info_record structure is passed into the visitor function.
     * If a call to the visitor function returns false, scanning will stop and this function will return.
     *
-    * @pre start_block_height <= end_block_height
+    * @pre start_key <= end_key
     * @returns number of rows visited
     */
-   unsigned int scan_blockinfo_table(uint32_t                               start_block_height,
-                                     uint32_t                               end_block_height,
+   unsigned int scan_blockinfo_table(uint64_t                               start_key,
+                                     uint64_t                               end_key,
                                      std::function<bool(block_info_record)> visitor) const
    {
-      FC_ASSERT(start_block_height <= end_block_height, "invalid inputs");
+      FC_ASSERT(start_key <= end_key, "invalid inputs");
 
       auto t_id = get_blockinfo_table_id();
       if (!t_id) {
@@ -97,8 +101,8 @@ public:
 
       block_info_record r;
 
-      for (auto itr = idx.lower_bound(boost::make_tuple(*t_id, static_cast<uint64_t>(start_block_height)));
-           itr != idx.end() && itr->t_id == *t_id && itr->primary_key <= end_block_height; ++itr) //
+      for (auto itr = idx.lower_bound(boost::make_tuple(*t_id, start_key));
+           itr != idx.end() && itr->t_id == *t_id && itr->primary_key <= end_key; ++itr) //
       {
          fc::datastream<const char*> ds(itr->value.data(), itr->value.size());
          fc::raw::unpack(ds, r);
@@ -111,15 +115,22 @@ public:
       return rows_visited;
    }
 
+   /**
+    * Returns all rows in blockinfo table in order of ascending block height.
+    */
    std::vector<block_info_record> get_blockinfo_table()
    {
       std::vector<block_info_record> result;
 
-      scan_blockinfo_table(0, std::numeric_limits<uint32_t>::max(), [&result](const block_info_record& r) {
+      scan_blockinfo_table(0, std::numeric_limits<uint64_t>::max(), [&result](const block_info_record& r) {
          result.push_back(r);
          return true;
       });
 
+      std::sort(result.begin(), result.end(), [](const block_info_record& lhs, const block_info_record& rhs) {
+         return lhs.block_height < rhs.block_height;
+      });
+
       return result;
    }
 
@@ -264,6 +275,7 @@ try {
    std::vector<block_info_record> expected_table;
    auto add_to_expected_table = [&expected_table](uint32_t block_height, fc::time_point block_timestamp) {
       expected_table.push_back(block_info_record{
+         .version         = slot_record_version,
          .block_height    = block_height,
          .block_timestamp = block_timestamp,
       });
@@ -299,7 +311,7 @@ try {
    BOOST_CHECK(rolling_window_size == actual_table.size());
    BOOST_CHECK(check_tables_match(expected_table, actual_table));
 
-   // Producing one more block should erase the start block from the table.
+   // Producing one more block should overwrite the slot of the start block in the table.
 
    produce_blocks(1);
 
@@ -310,6 +322,24 @@ try {
    actual_table = get_blockinfo_table();
    BOOST_CHECK(rolling_window_size == actual_table.size());
    BOOST_CHECK(check_tables_match(expected_table, actual_table));
+
+   // The new block took over the slot of the start block.
+   unsigned int rows_in_slot = scan_blockinfo_table(start_block_height % rolling_window_size,
+                                                    start_block_height % rolling_window_size,
+                                                    [&](const block_info_record& r) {
+                                                       BOOST_CHECK(r == expected_table.back());
+                                                       return true;
+                                                    });
+   BOOST_CHECK(rows_in_slot == 1);
+
+   // The window never grows past its fixed slots.
+
+   produce_blocks(2 * rolling_window_size);
+
+   actual_table = get_blockinfo_table();
+   BOOST_CHECK(rolling_window_size == actual_table.size());
+   BOOST_CHECK(actual_table.back().block_height == control->head_block_num());
+   BOOST_CHECK(actual_table.front().block_height == control->head_block_num() - rolling_window_size + 1);
 }
 FC_LOG_AND_RETHROW()
 
@@ -550,4 +580,67 @@ try {
 }
 FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(summary_batch_tests, block_info_tester)
+try {
+   create_account_with_resources(blockinfo_tester_account_name, config::system_account_name,
+                                 core_sym::from_string("10.0000"), false);
+   set_code(blockinfo_tester_account_name, test_contracts::blockinfo_tester_wasm());
+
+   auto latest_block_batch_info = [this](uint32_t batch_start_height_offset,
+                                         uint32_t batch_size) -> blockinfo_tester::latest_block_batch_info_result //
+   {
+      auto result = get_latest_block_batch_info(blockinfo_tester::get_latest_block_batch_info{
+         .batch_start_height_offset = batch_start_height_offset,
+         .batch_size                = batch_size,
+      });
+      BOOST_REQUIRE(result.first.has_value());
+      return *result.first;
+   };
+
+   // Advance to the next block starting an hourly batch.
+   produce_blocks(1);
+   while (control->head_block_num() % hourly_batch_size != 0) {
+      produce_blocks(1);
+   }
+
+   auto batch_start_height    = control->head_block_num();
+   auto batch_start_timestamp = control->head_block_time();
+
+   // Move the start of the batch out of the rolling window.
+   produce_blocks(rolling_window_size + 5);
+   BOOST_REQUIRE(control->head_block_num() - batch_start_height >= rolling_window_size);
+
+   // The hourly batch is still answered from the hourly summary.
+   {
+      auto result = latest_block_batch_info(0, hourly_batch_size);
+      BOOST_REQUIRE(!result.has_error());
+      BOOST_CHECK(result.result->batch_start_height == batch_start_height);
+      BOOST_CHECK(result.result->batch_start_timestamp == batch_start_timestamp);
+      BOOST_CHECK(result.result->batch_current_end_height == control->head_block_num());
+      BOOST_CHECK(result.result->batch_current_end_timestamp == control->head_block_time());
+   }
+
+   // Batches not aligned to a summarized batch size only reach back as far as the rolling window.
+   {
+      auto result = latest_block_batch_info(1, hourly_batch_size);
+      BOOST_CHECK(result.has_error());
+      BOOST_CHECK(result.get_error() ==
+                  blockinfo_tester::latest_block_batch_info_result::error_code_enum::insufficient_data);
+   }
+
+   // The next hourly batch replaces it once it starts.
+   while (control->head_block_num() % hourly_batch_size != 0) {
+      produce_blocks(1);
+   }
+   produce_blocks(rolling_window_size);
+
+   {
+      auto result = latest_block_batch_info(0, hourly_batch_size);
+      BOOST_REQUIRE(!result.has_error());
+      BOOST_CHECK(result.result->batch_start_height == batch_start_height + hourly_batch_size);
+      BOOST_CHECK(result.result->batch_current_end_height == control->head_block_num());
+   }
+}
+FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
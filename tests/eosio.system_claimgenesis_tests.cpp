@@ -823,4 +823,59 @@ BOOST_FIXTURE_TEST_CASE( genesis_plus_delegate_extra_bw_to_someone_else, eosio_s
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( purge_genesis_after_final_time, eosio_system_tester ) try {
+   deploy_system_v31_contract();
+   cross_15_percent_threshold();
+   const uint64_t nonce = 1;
+   const asset net = core_sym::from_string("80.0000");
+   const asset cpu = core_sym::from_string("80.0000");
+   const std::vector<account_name> accounts = {"user11111111"_n, "user22222222"_n };
+   for (const auto& a: accounts) {
+      create_account_with_resources( a, config::system_account_name, core_sym::from_string("10.0000"), false, net, cpu );
+   }
+
+   // This transer creates a sub_balance for genesis.wax account
+   transfer( "eosio"_n, "genesis.wax"_n, core_sym::from_string("1000.0000"), "eosio"_n );
+
+   const asset genesis_tokens_user1{core_sym::from_string("2.0000")};
+   const asset genesis_tokens_user2{core_sym::from_string("1.0000")};
+
+   // Lock genesis tokens to users
+   awardgenesis( "user11111111"_n, genesis_tokens_user1, nonce + 1);
+   awardgenesis( "user22222222"_n, genesis_tokens_user2, nonce + 2);
+
+   deploy_contract(false);
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("cannot purge genesis state before the end of GBM"), purgegenesis( 10 ) );
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "user11111111"_n, "purgegenesis"_n, mvo()( "max", 10 ) ) );
+
+   // GBM period is over
+   produce_block(fc::days(3*365 + 366));
+
+   // only the first award is settled
+   BOOST_REQUIRE_EQUAL( success(), purgegenesis( 1 ) );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user1, get_balance("user11111111"_n) );
+   BOOST_REQUIRE( get_genesis( "user11111111"_n ).is_null() );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user2, get_genesis_balance( "user22222222"_n ) );
+
+   // genesis is retired, unstaking awarded tokens no longer touches the remaining genesis row
+   BOOST_REQUIRE_EQUAL( success(), unstake( "user22222222"_n, "user22222222"_n,
+                                            core_sym::from_string("0.5000"), core_sym::from_string("0.5000") ) );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user2, get_genesis_balance( "user22222222"_n ) );
+
+   // a receiver can be settled directly, its genonce row is then dropped without paying twice
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( "user11111111"_n, "purgegenacct"_n, mvo()( "receivers", accounts ) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("receivers cannot be empty"), purgegenacct( {} ) );
+   BOOST_REQUIRE_EQUAL( success(), purgegenacct( accounts ) );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user2, get_balance("user22222222"_n) );
+   BOOST_REQUIRE( get_genesis( "user22222222"_n ).is_null() );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user1, get_balance("user11111111"_n) );
+
+   BOOST_REQUIRE_EQUAL( success(), purgegenesis( 10 ) );
+   BOOST_REQUIRE_EQUAL( genesis_tokens_user2, get_balance("user22222222"_n) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no genesis balance object found"), claimgenesis( "user22222222"_n ) );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -275,6 +275,14 @@ public:
 		 mvo()( "claimer",claimer) );
    }
 
+   action_result purgegenesis( uint32_t max ) {
+      return push_action( config::system_account_name, "purgegenesis"_n, mvo()( "max", max ) );
+   }
+
+   action_result purgegenacct( const std::vector<account_name>& receivers ) {
+      return push_action( config::system_account_name, "purgegenacct"_n, mvo()( "receivers", receivers ) );
+   }
+
    action_result buyram( const account_name& payer, account_name receiver, const asset& eosin ) {
       return push_action( payer, "buyram"_n, mvo()( "payer",payer)("receiver",receiver)("quant",eosin) );
    }
@@ -152,10 +152,28 @@ BOOST_FIXTURE_TEST_CASE( buysell, eosio_system_tester ) try {
       uint64_t bytes1 = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64();
 
       const int64_t fee = (payment.get_amount() + 199) / 200;
-      const double net_payment = payment.get_amount() - fee;
-      const int64_t expected_delta = net_payment * r0.get_amount() / ( net_payment + e0.get_amount() );
+      const int64_t net_payment = payment.get_amount() - fee;
+      const int64_t expected_delta = __int128(net_payment) * r0.get_amount() / ( __int128(net_payment) + e0.get_amount() );
 
       BOOST_REQUIRE_EQUAL( expected_delta, bytes1 -  bytes0 );
+
+      // the floating point conversion previously used agrees up to its rounding
+      const double approx_delta = double(net_payment) * r0.get_amount() / ( double(net_payment) + e0.get_amount() );
+      BOOST_REQUIRE( within_one( int64_t(approx_delta), bytes1 - bytes0 ) );
+
+      market = get_ram_market();
+      const asset r1 = market["base"].as<connector>().balance;
+      const asset e1 = market["quote"].as<connector>().balance;
+      BOOST_REQUIRE_EQUAL( r0.get_amount() - expected_delta, r1.get_amount() );
+      BOOST_REQUIRE_EQUAL( e0.get_amount() + net_payment, e1.get_amount() );
+
+      const auto balance0 = get_balance( "alice1111111" );
+      const int64_t sold = (bytes1 - bytes0) / 3;
+      BOOST_REQUIRE_EQUAL( success(), sellram( "alice1111111", sold ) );
+
+      const int64_t tokens_out = __int128(sold) * e1.get_amount() / ( __int128(sold) + r1.get_amount() );
+      const int64_t sell_fee = (tokens_out + 199) / 200;
+      BOOST_REQUIRE_EQUAL( tokens_out - sell_fee, (get_balance( "alice1111111" ) - balance0).get_amount() );
    }
 
    {
@@ -175,6 +193,85 @@ BOOST_FIXTURE_TEST_CASE( buysell, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( ram_price_history, eosio_system_tester ) try {
+   auto get_history = [&]() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "ramprice"_n, "ramprice"_n );
+      BOOST_REQUIRE( !data.empty() );
+      return abi_ser.binary_to_variant( "ram_price_history", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   };
+   auto get_price = [&]() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name,
+                                              "rammarket"_n, account_name(symbol{SY(4,RAMCORE)}.value()) );
+      auto market = abi_ser.binary_to_variant( "exchange_state", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+      return unsigned __int128( market["quote"]["balance"].as<asset>().get_amount() ) * 1'000'000'000'000ull
+             / market["base"]["balance"].as<asset>().get_amount();
+   };
+   auto to_uint128 = []( const fc::variant& v ) {
+      unsigned __int128 r = 0;
+      for( char c : v.as_string() ) r = r * 10 + ( c - '0' );
+      return r;
+   };
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_sym::from_string("100.0000") ) );
+
+   auto h0 = get_history();
+   const auto p0 = get_price();
+   const auto t0 = h0["last"]["time"].as<fc::time_point_sec>();
+
+   // the price in effect since the last trade is accumulated by the next one
+   produce_block( fc::hours(2) );
+   BOOST_REQUIRE_EQUAL( success(), sellram( "alice1111111", 1024 ) );
+   auto h1 = get_history();
+   const auto t1 = h1["last"]["time"].as<fc::time_point_sec>();
+   BOOST_REQUIRE( t1 > t0 );
+   BOOST_REQUIRE( to_uint128( h0["last"]["cumulative_price"] ) + p0 * ( t1.sec_since_epoch() - t0.sec_since_epoch() )
+                  == to_uint128( h1["last"]["cumulative_price"] ) );
+
+   // more than an hour since the previous sample, so the latest sample is the accumulated value
+   const auto samples = h1["samples"].get_array();
+   const auto& head = samples[ h1["head"].as<uint32_t>() ];
+   BOOST_REQUIRE( t1 == head["time"].as<fc::time_point_sec>() );
+   BOOST_REQUIRE( to_uint128( h1["last"]["cumulative_price"] ) == to_uint128( head["cumulative_price"] ) );
+
+   // within the same hour only the accumulated value moves
+   produce_block( fc::minutes(10) );
+   BOOST_REQUIRE_EQUAL( success(), sellram( "alice1111111", 1024 ) );
+   auto h2 = get_history();
+   BOOST_REQUIRE_EQUAL( h1["head"].as<uint32_t>(), h2["head"].as<uint32_t>() );
+   BOOST_REQUIRE( t1 == h2["samples"].get_array()[ h2["head"].as<uint32_t>() ]["time"].as<fc::time_point_sec>() );
+   BOOST_REQUIRE( h2["last"]["time"].as<fc::time_point_sec>() > t1 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( buyrammany, eosio_system_tester ) try {
+   transfer( config::system_account_name, "carol1111111"_n, core_sym::from_string("100000.0000"), config::system_account_name );
+
+   const uint64_t alice0 = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64();
+   const uint64_t bob0   = get_total_stake( "bob111111111" )["ram_bytes"].as_uint64();
+   const auto carol0 = get_balance( "carol1111111" );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("purchases cannot be empty"),
+                        push_action( "carol1111111"_n, "buyrammany"_n, mvo()("payer", "carol1111111")("purchases", variants()) ) );
+
+   auto trace = base_tester::push_action( config::system_account_name, "buyrammany"_n, "carol1111111"_n, mvo()
+                                          ("payer", "carol1111111")
+                                          ("purchases", variants{ mvo()("receiver", "alice1111111")("bytes", 1024 * 1024),
+                                                                  mvo()("receiver", "bob111111111")("bytes", 4096) }) );
+   BOOST_REQUIRE( within_one( 1024 * 1024, get_total_stake( "alice1111111" )["ram_bytes"].as_uint64() - alice0 ) );
+   BOOST_REQUIRE( within_one( 4096, get_total_stake( "bob111111111" )["ram_bytes"].as_uint64() - bob0 ) );
+
+   // one payment and one fee transfer for the whole batch
+   BOOST_REQUIRE_EQUAL( 2, std::count_if( trace->action_traces.begin(), trace->action_traces.end(), []( const auto& at ) {
+      return at.receiver == "eosio.token"_n && at.act.name == "transfer"_n;
+   }) );
+
+   auto results = abi_ser.binary_to_variant( "action_return_buyram[]", trace->action_traces[0].return_value,
+                                             abi_serializer::create_yield_function(abi_serializer_max_time) ).get_array();
+   BOOST_REQUIRE_EQUAL( 2u, results.size() );
+   BOOST_REQUIRE_EQUAL( carol0 - get_balance( "carol1111111" ),
+                        results[0]["quantity"].as<asset>() + results[1]["quantity"].as<asset>() );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -247,6 +344,240 @@ BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( stake_unstake_many, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   const auto init_eosio_stake_balance = get_balance( "eosio.stake"_n );
+
+   auto delegation = []( std::string_view receiver, std::string_view net, std::string_view cpu ) {
+      return mvo()("receiver", receiver)("net", core_sym::from_string(net))("cpu", core_sym::from_string(cpu));
+   };
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("delegations cannot be empty"),
+                        push_action( "alice1111111"_n, "delegatebwmany"_n, mvo()("from", "alice1111111")("delegations", variants()) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("must stake a positive amount"),
+                        push_action( "alice1111111"_n, "delegatebwmany"_n, mvo()("from", "alice1111111")
+                                     ("delegations", variants{ delegation("bob111111111", "0.0000", "0.0000") }) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "delegatebwmany"_n, mvo()
+                                                ("from", "alice1111111")
+                                                ("delegations", variants{ delegation("alice1111111", "100.0000", "50.0000"),
+                                                                          delegation("bob111111111", "200.0000", "100.0000"),
+                                                                          delegation("carol1111111", "10.0000", "20.0000") }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("520.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( init_eosio_stake_balance + core_sym::from_string("480.0000"), get_balance( "eosio.stake"_n ) );
+   REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("480.0000") ), get_voter_info( "alice1111111" ) );
+
+   auto total = get_total_stake( "bob111111111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("210.0000"), total["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("110.0000"), total["cpu_weight"].as<asset>() );
+   total = get_total_stake( "carol1111111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), total["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), total["cpu_weight"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "undelegatebwmany"_n, mvo()
+                                                ("from", "alice1111111")
+                                                ("delegations", variants{ delegation("alice1111111", "100.0000", "50.0000"),
+                                                                          delegation("bob111111111", "200.0000", "100.0000") }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("520.0000"), get_balance( "alice1111111" ) );
+   REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("30.0000") ), get_voter_info( "alice1111111" ) );
+   auto refund = get_refund_request( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("300.0000"), refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("150.0000"), refund["cpu_amount"].as<asset>() );
+   total = get_total_stake( "bob111111111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), total["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), total["cpu_weight"].as<asset>() );
+
+   // staking to self again is taken back from the pending refund, the rest is transferred
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "delegatebwmany"_n, mvo()
+                                                ("from", "alice1111111")
+                                                ("delegations", variants{ delegation("alice1111111", "100.0000", "50.0000"),
+                                                                          delegation("bob111111111", "20.0000", "0.0000") }) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("500.0000"), get_balance( "alice1111111" ) );
+   refund = get_refund_request( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("200.0000"), refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000"), refund["cpu_amount"].as<asset>() );
+   REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("200.0000") ), get_voter_info( "alice1111111" ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( account_limits_cached_per_action, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+
+   auto delegation = []( std::string_view receiver, std::string_view net, std::string_view cpu ) {
+      return mvo()("receiver", receiver)("net", core_sym::from_string(net))("cpu", core_sym::from_string(cpu));
+   };
+   // the limits written when the action ends must match the account's `userres` row
+   auto check_limits = [&]( name account ) {
+      int64_t ram_bytes, net_weight, cpu_weight;
+      control->get_resource_limits_manager().get_account_limits( account, ram_bytes, net_weight, cpu_weight );
+      auto total = get_total_stake( account );
+      BOOST_REQUIRE_EQUAL( total["net_weight"].as<asset>().get_amount(), net_weight );
+      BOOST_REQUIRE_EQUAL( total["cpu_weight"].as<asset>().get_amount(), cpu_weight );
+      BOOST_REQUIRE_EQUAL( total["ram_bytes"].as_int64() + 1400, ram_bytes );
+   };
+
+   // several changes to the same accounts in one action
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "delegatebwmany"_n, mvo()
+                                                ("from", "alice1111111")
+                                                ("delegations", variants{ delegation("alice1111111", "100.0000", "50.0000"),
+                                                                          delegation("bob111111111", "20.0000", "10.0000"),
+                                                                          delegation("alice1111111", "30.0000", "0.0000"),
+                                                                          delegation("bob111111111", "0.0000", "5.0000") }) ) );
+   check_limits( "alice1111111"_n );
+   check_limits( "bob111111111"_n );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), get_total_stake( "bob111111111" )["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("25.0000"), get_total_stake( "bob111111111" )["cpu_weight"].as<asset>() );
+
+   const int64_t bob_ram = get_total_stake( "bob111111111" )["ram_bytes"].as_int64();
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice1111111"_n, "buyrammany"_n, mvo()
+                                                ("payer", "alice1111111")
+                                                ("purchases", variants{ mvo()("receiver", "bob111111111")("bytes", 1000),
+                                                                        mvo()("receiver", "bob111111111")("bytes", 2000) }) ) );
+   BOOST_REQUIRE_EQUAL( bob_ram + 3000, get_total_stake( "bob111111111" )["ram_bytes"].as_int64() );
+   check_limits( "bob111111111"_n );
+
+   // and in several actions of one transaction
+   {
+      signed_transaction trx;
+      set_transaction_headers(trx);
+      trx.actions.emplace_back( get_action( config::system_account_name, "delegatebwmany"_n, { {"alice1111111"_n, config::active_name} },
+                                            mvo()("from", "alice1111111")
+                                                 ("delegations", variants{ delegation("alice1111111", "10.0000", "10.0000") }) ) );
+      trx.actions.emplace_back( get_action( config::system_account_name, "buyram"_n, { {"alice1111111"_n, config::active_name} },
+                                            mvo()("payer", "alice1111111")("receiver", "alice1111111")
+                                                 ("quant", core_sym::from_string("10.0000")) ) );
+      trx.actions.emplace_back( get_action( config::system_account_name, "undelegatebw"_n, { {"alice1111111"_n, config::active_name} },
+                                            mvo()("from", "alice1111111")("receiver", "alice1111111")
+                                                 ("unstake_net_quantity", core_sym::from_string("5.0000"))
+                                                 ("unstake_cpu_quantity", core_sym::from_string("0.0000")) ) );
+      trx.sign( get_private_key( "alice1111111"_n, "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   }
+   check_limits( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("145.0000"), get_total_stake( "alice1111111" )["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("70.0000"), get_total_stake( "alice1111111" )["cpu_weight"].as<asset>() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( undelegate_all, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "carol1111111", core_sym::from_string("0.0000"), core_sym::from_string("30.0000") ) );
+
+   auto is_delegator = [&]( name receiver, name from ) {
+      return !get_row_by_account( config::system_account_name, receiver, "delegators"_n, from ).empty();
+   };
+   BOOST_REQUIRE( is_delegator( "bob111111111"_n, "alice1111111"_n ) );
+   BOOST_REQUIRE( is_delegator( "carol1111111"_n, "alice1111111"_n ) );
+
+   // filling the index pages through the delegations and leaves existing rows alone
+   auto filldelegs = [&]( name cursor, uint16_t max ) {
+      auto trace = base_tester::push_action( config::system_account_name, "filldelegs"_n, "bob111111111"_n,
+                                             mvo()("from", "alice1111111")("cursor", cursor)("max", max) );
+      return fc::raw::unpack<name>( trace->action_traces[0].return_value );
+   };
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("max must be greater than 0"),
+                        push_action( "bob111111111"_n, "filldelegs"_n, mvo()("from", "alice1111111")("cursor", name())("max", 0) ) );
+   BOOST_REQUIRE_EQUAL( "carol1111111"_n, filldelegs( name(), 2 ) );
+   BOOST_REQUIRE_EQUAL( name(), filldelegs( "carol1111111"_n, 2 ) );
+   BOOST_REQUIRE( is_delegator( "alice1111111"_n, "alice1111111"_n ) );
+   BOOST_REQUIRE( is_delegator( "carol1111111"_n, "alice1111111"_n ) );
+
+   auto undelegateall = [&]( name cursor, uint16_t max ) {
+      auto trace = base_tester::push_action( config::system_account_name, "undelegateall"_n, "alice1111111"_n,
+                                             mvo()("from", "alice1111111")("cursor", cursor)("max", max) );
+      return fc::raw::unpack<name>( trace->action_traces[0].return_value );
+   };
+
+   // alice1111111 and bob111111111, then carol1111111
+   BOOST_REQUIRE_EQUAL( "carol1111111"_n, undelegateall( name(), 2 ) );
+   BOOST_REQUIRE_EQUAL( false, is_delegator( "bob111111111"_n, "alice1111111"_n ) );
+   BOOST_REQUIRE( is_delegator( "carol1111111"_n, "alice1111111"_n ) );
+   REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("30.0000") ), get_voter_info( "alice1111111" ) );
+
+   BOOST_REQUIRE_EQUAL( name(), undelegateall( "carol1111111"_n, 2 ) );
+   BOOST_REQUIRE_EQUAL( false, is_delegator( "carol1111111"_n, "alice1111111"_n ) );
+   REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("0.0000") ), get_voter_info( "alice1111111" ) );
+
+   auto refund = get_refund_request( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("120.0000"), refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("90.0000"), refund["cpu_amount"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("nothing to undelegate"),
+                        push_action( "alice1111111"_n, "undelegateall"_n, mvo()("from", "alice1111111")("cursor", name())("max", 2) ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( process_matured_refunds, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"), config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", "bob111111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   issue_and_transfer( "carol1111111", core_sym::from_string("1000.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", "carol1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+
+   auto autorefund = [&]( name owner, bool enabled ) {
+      return push_action( owner, "autorefund"_n, mvo()("owner", owner)("enabled", enabled) );
+   };
+   BOOST_REQUIRE_EQUAL( error("missing authority of bob111111111"),
+                        push_action( "alice1111111"_n, "autorefund"_n, mvo()("owner", "bob111111111")("enabled", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), autorefund( "bob111111111"_n, true ) );
+
+   // alice's refund request is made before she opts in, carol never opts in
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "carol1111111", "carol1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), autorefund( "alice1111111"_n, true ) );
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE( get_row_by_account( config::system_account_name, config::system_account_name, "refundqueue"_n, "carol1111111"_n ).empty() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("max must be greater than 0"),
+                        push_action( "carol1111111"_n, "processrefunds"_n, mvo()("max", 0) ) );
+
+   // nothing is due yet
+   BOOST_REQUIRE_EQUAL( success(), push_action( "carol1111111"_n, "processrefunds"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( false, get_refund_request( "alice1111111"_n ).is_null() );
+
+   // only alice's refund is due
+   produce_block( fc::hours(3*24-1) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), push_action( "carol1111111"_n, "processrefunds"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( true, get_refund_request( "alice1111111"_n ).is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "carol1111111" ) );
+   BOOST_REQUIRE_EQUAL( false, get_refund_request( "carol1111111"_n ).is_null() );
+
+   // bob's refund is due, but is claimed through refund first
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refund is not due yet"),
+                        push_action( "carol1111111"_n, "parkrefund"_n, mvo()("owner", "bob111111111") ) );
+   produce_block( fc::hours(1) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "refund"_n, mvo()("owner", "bob111111111") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("730.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "carol1111111"_n, "processrefunds"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("730.0000"), get_balance( "bob111111111" ) );
+
+   // a due refund can be parked, then only refund pays it
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   produce_block( fc::days(3) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), push_action( "carol1111111"_n, "parkrefund"_n, mvo()("owner", "bob111111111") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refund is not queued"),
+                        push_action( "carol1111111"_n, "parkrefund"_n, mvo()("owner", "bob111111111") ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "carol1111111"_n, "processrefunds"_n, mvo()("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("730.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "refund"_n, mvo()("owner", "bob111111111") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("760.0000"), get_balance( "bob111111111" ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake_with_transfer, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -3850,6 +4181,37 @@ BOOST_FIXTURE_TEST_CASE( bid_invalid_names, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( namebid_refunds_by_bidder, eosio_system_tester ) try {
+   std::vector<account_name> accounts = { "alice"_n, "bob"_n };
+   create_accounts_with_resources( accounts );
+   for ( const auto& a: accounts ) {
+      transfer( config::system_account_name, a, core_sym::from_string( "10000.0000" ) );
+   }
+
+   bidname( "bob", "prefa", core_sym::from_string("1.0000") );
+   bidname( "bob", "prefb", core_sym::from_string("2.0000") );
+   bidname( "bob", "prefc", core_sym::from_string("3.0000") );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9994.0000" ), get_balance("bob") );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "refund not found" ),
+                        push_action( "bob"_n, "bidrefunds"_n, mvo()("bidder", "bob")("max", 10) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice", "prefa", core_sym::from_string("1.2000") ) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice", "prefb", core_sym::from_string("2.3000") ) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice", "prefc", core_sym::from_string("3.4000") ) );
+
+   // refunds are taken in name order: prefa and prefb, then prefc
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob"_n, "bidrefunds"_n, mvo()("bidder", "bob")("max", 2) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9997.0000" ), get_balance("bob") );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "refund not found" ),
+                        push_action( "bob"_n, "bidrefund"_n, mvo()("bidder", "bob")("newname", "prefb") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob"_n, "bidrefunds"_n, mvo()("bidder", "bob")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "10000.0000" ), get_balance("bob") );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "refund not found" ),
+                        push_action( "bob"_n, "bidrefunds"_n, mvo()("bidder", "bob")("max", 10) ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
 
    const std::string not_closed_message("auction for name is not closed yet");
@@ -4005,6 +4367,42 @@ BOOST_FIXTURE_TEST_CASE( namebid_pending_winner, eosio_system_tester ) try {
    create_account_with_resources( "prefb"_n, "bob111111111"_n );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( namebid_prune_unclaimed, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+   produce_block( fc::hours(14*24) );    //wait 14 day for name auction activation
+   transfer( config::system_account_name, "alice1111111"_n, core_sym::from_string("10000.0000") );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "50.0000" ) ));
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "9950.0000" ), get_balance("alice1111111") );
+   produce_block( fc::hours(100) ); //should close "prefa"
+   produce_blocks(2);
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "bid pruning is disabled" ),
+                        push_action( "bob111111111"_n, "prunebids"_n, mvo()("cursor", "")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio" ),
+                        push_action( "bob111111111"_n, "cfgbidprune"_n, mvo()("grace_sec", 30 * 24 * 3600) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "grace period is too short" ),
+                        push_action( config::system_account_name, "cfgbidprune"_n, mvo()("grace_sec", 24 * 3600) ) );
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, "cfgbidprune"_n, mvo()("grace_sec", 30 * 24 * 3600) ) );
+
+   // still within the grace period
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "prunebids"_n, mvo()("cursor", "")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "refund not found" ),
+                        push_action( "alice1111111"_n, "bidrefund"_n, mvo()("bidder", "alice1111111")("newname", "prefa") ) );
+
+   produce_block( fc::days(30) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "prunebids"_n, mvo()("cursor", "")("max", 10) ) );
+   BOOST_REQUIRE_EXCEPTION( create_account_with_resources( "prefa"_n, "alice1111111"_n ),
+                            fc::exception, fc_assert_exception_message_is( "no active bid for name" ) );
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( "alice1111111"_n, "bidrefunds"_n, mvo()("bidder", "alice1111111")("max", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string( "10000.0000" ), get_balance("alice1111111") );
+
+   // the name can be auctioned again
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "1.0000" ) ));
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
 
    const asset net = core_sym::from_string("80.0000");
@@ -4393,6 +4791,41 @@ BOOST_FIXTURE_TEST_CASE( eosioram_ramusage, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( ramtransfer, eosio_system_tester ) try {
+   const uint64_t ram_gift = 1400;
+   auto rlm = control->get_resource_limits_manager();
+   auto ram_limit = [&]( name account ) {
+      int64_t ram_bytes, net_weight, cpu_weight;
+      rlm.get_account_limits( account, ram_bytes, net_weight, cpu_weight );
+      return ram_bytes;
+   };
+   auto ramtransfer = [&]( name from, name to, int64_t bytes ) {
+      return push_action( from, "ramtransfer"_n, mvo()("from", from)("to", to)("bytes", bytes) );
+   };
+
+   transfer( "eosio", "alice1111111", core_sym::from_string("1000.0000"), "eosio" );
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_sym::from_string("100.0000") ) );
+
+   const uint64_t alice0 = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64();
+   const uint64_t bob0   = get_total_stake( "bob111111111" )["ram_bytes"].as_uint64();
+   const auto ram_balance = get_balance( "eosio.ram"_n );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("must transfer a positive amount"), ramtransfer( "alice1111111"_n, "bob111111111"_n, 0 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("cannot transfer ram to self"), ramtransfer( "alice1111111"_n, "alice1111111"_n, 1 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient quota"), ramtransfer( "alice1111111"_n, "bob111111111"_n, alice0 + 1 ) );
+   BOOST_REQUIRE_EQUAL( error("missing authority of alice1111111"),
+                        push_action( "bob111111111"_n, "ramtransfer"_n, mvo()("from", "alice1111111")("to", "bob111111111")("bytes", 1) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), ramtransfer( "alice1111111"_n, "bob111111111"_n, 1024 ) );
+   BOOST_REQUIRE_EQUAL( alice0 - 1024, get_total_stake( "alice1111111" )["ram_bytes"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( bob0 + 1024, get_total_stake( "bob111111111" )["ram_bytes"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( alice0 - 1024 + ram_gift, ram_limit( "alice1111111"_n ) );
+   BOOST_REQUIRE_EQUAL( bob0 + 1024 + ram_gift, ram_limit( "bob111111111"_n ) );
+
+   // the ram market is not involved
+   BOOST_REQUIRE_EQUAL( ram_balance, get_balance( "eosio.ram"_n ) );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( ram_gift, eosio_system_tester ) try {
    active_and_vote_producers();
 
@@ -4531,6 +4964,7 @@ BOOST_FIXTURE_TEST_CASE( change_limited_account_back_to_unlimited, eosio_system_
       ("net_weight", core_sym::from_string("0.0000"))
       ("cpu_weight", core_sym::from_string("1.0000"))
       ("ram_bytes",  0)
+      ("flags1",     0)
    );
 
    BOOST_REQUIRE_EQUAL( wasm_assert_msg( "only supports unlimited accounts" ),
@@ -4566,6 +5000,9 @@ BOOST_FIXTURE_TEST_CASE( change_limited_account_back_to_unlimited, eosio_system_
                         )
    );
 
+   // net_managed | cpu_managed, kept with the resources of eosio
+   BOOST_REQUIRE_EQUAL( 6u, get_total_stake( "eosio" )["flags1"].as<uint32_t>() );
+
    BOOST_REQUIRE_EQUAL( success(),
                         push_action( "eosio"_n, "setalimits"_n, mvo()
                                           ("account", "eosio.saving")
@@ -4609,6 +5046,7 @@ BOOST_FIXTURE_TEST_CASE( buy_pin_sell_ram, eosio_system_tester ) try {
       ("net_weight", core_sym::from_string("0.0000"))
       ("cpu_weight", core_sym::from_string("0.0000"))
       ("ram_bytes",  total_res["ram_bytes"].as_int64() )
+      ("flags1",     0)
    );
 
    BOOST_REQUIRE_EQUAL( wasm_assert_msg( "only supports unlimited accounts" ),
@@ -4627,6 +5065,9 @@ BOOST_FIXTURE_TEST_CASE( buy_pin_sell_ram, eosio_system_tester ) try {
                         )
    );
 
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer ram from an account with managed ram" ),
+                        push_action( "eosio"_n, "ramtransfer"_n, mvo()("from", "eosio")("to", "alice1111111")("bytes", 1) ) );
+
    auto eosio_original_balance = get_balance( "eosio"_n );
 
    BOOST_REQUIRE_EQUAL( success(), sellram( "eosio"_n, total_res["ram_bytes"].as_int64() ) );
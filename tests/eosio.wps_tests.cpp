@@ -248,6 +248,16 @@ public:
         );
     }
 
+    action_result rmvreject(name sender, name reviewer, name proposer) {
+        return push_action(
+                sender,
+                "rmvreject"_n,
+                mvo()
+                        ("reviewer", reviewer)
+                        ("proposer", proposer)
+        );
+    }
+
     action_result rejectfund(name sender, name committeeman, name proposer, const string& reason) {
         return push_action(
                 sender,
@@ -307,16 +317,45 @@ public:
                 ("producers", producers));
     }
 
-    action_result cleanvotes(name sender, name reviewer, name proposer, uint64_t begin, uint64_t end) {
+    action_result cleanvotes(name sender, name reviewer, name proposer, name cursor, uint16_t max) {
         return push_action(
                 sender,
                 "cleanvotes"_n,
                 mvo()
                         ("reviewer", reviewer)
                         ("proposer", proposer)
-                        ("begin", begin)
-                        ("end", end)
+                        ("cursor", cursor)
+                        ("max", max)
+        );
+    }
+
+    name cleanvotes_next(name reviewer, name proposer, name cursor, uint16_t max) {
+        auto trace = base_tester::push_action(config::system_account_name, "cleanvotes"_n, reviewer,
+                mvo()
+                        ("reviewer", reviewer)
+                        ("proposer", proposer)
+                        ("cursor", cursor)
+                        ("max", max)
         );
+        return fc::raw::unpack<name>(trace->action_traces[0].return_value);
+    }
+
+    name fillpropvote_next(name cursor, uint16_t max) {
+        auto trace = base_tester::push_action(config::system_account_name, "fillpropvote"_n, "alice1111111"_n,
+                mvo()
+                        ("cursor", cursor)
+                        ("max", max)
+        );
+        return fc::raw::unpack<name>(trace->action_traces[0].return_value);
+    }
+
+    bool rmvreject_done(name reviewer, name proposer) {
+        auto trace = base_tester::push_action(config::system_account_name, "rmvreject"_n, reviewer,
+                mvo()
+                        ("reviewer", reviewer)
+                        ("proposer", proposer)
+        );
+        return fc::raw::unpack<bool>(trace->action_traces[0].return_value);
     }
 
     fc::variant get_committee(const account_name& act) {
@@ -339,10 +378,20 @@ public:
         return data.empty() ? fc::variant() : abi_ser.binary_to_variant("proposal", data, abi_serializer_max_time);
     }
 
+    fc::variant get_proposal_tally(const account_name& act) {
+        vector<char> data = get_row_by_account(config::system_account_name, config::system_account_name, "proptally"_n, act);
+        return data.empty() ? fc::variant() : abi_ser.binary_to_variant("proposal_tally", data, abi_serializer_max_time);
+    }
+
     fc::variant get_wpsvoter(const account_name& act) {
         vector<char> data = get_row_by_account(config::system_account_name, config::system_account_name, "wpsvoters"_n, act);
         return data.empty() ? fc::variant() : abi_ser.binary_to_variant("wps_voter", data, abi_serializer_max_time);
     }
+
+    fc::variant get_proposal_voter(const account_name& proposer, const account_name& act) {
+        vector<char> data = get_row_by_account(config::system_account_name, proposer, "propvoters"_n, act);
+        return data.empty() ? fc::variant() : abi_ser.binary_to_variant("wps_proposal_voter", data, abi_serializer_max_time);
+    }
 };
 
 BOOST_FIXTURE_TEST_CASE(wpsenv_set, eosio_wps_tester) try {
@@ -550,9 +599,10 @@ BOOST_REQUIRE_EQUAL(success(),
 
 produce_blocks(1);
 
-auto proposal = get_proposal("proposer1111"_n);
+auto tally = get_proposal_tally("proposer1111"_n);
 
-BOOST_REQUIRE_EQUAL(proposal["status"], 2);
+BOOST_REQUIRE_EQUAL(tally["status"], 2);
+BOOST_REQUIRE_EQUAL(get_proposal("proposer1111"_n)["status"], 2);
 
 produce_blocks(1);
 
@@ -560,9 +610,12 @@ BOOST_REQUIRE_EQUAL(success(), acceptprop("reviewer1111"_n, "reviewer1111"_n, "p
 
 produce_blocks(1);
 
-proposal = get_proposal("proposer2222"_n);
+tally = get_proposal_tally("proposer2222"_n);
+
+BOOST_REQUIRE_EQUAL(tally["status"], 3);
 
-BOOST_REQUIRE_EQUAL(proposal["status"], 3);
+// the status change is mirrored into the proposal
+BOOST_REQUIRE_EQUAL(get_proposal("proposer2222"_n)["status"], 3);
 
 } FC_LOG_AND_RETHROW()
 
@@ -622,17 +675,22 @@ core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
 
     produce_blocks(1);
 
-    auto proposal = get_proposal("proposer1111"_n);
+    auto tally = get_proposal_tally("proposer1111"_n);
 
-    BOOST_REQUIRE_EQUAL(proposal["status"], 3);
+    BOOST_REQUIRE_EQUAL(tally["status"], 3);
+    // a vote that doesn't change the status leaves the proposal alone
+    BOOST_REQUIRE(tally["total_votes"].as_double() > 0);
+    BOOST_REQUIRE_EQUAL(get_proposal("proposer1111"_n)["total_votes"].as_double(), 0);
 
     BOOST_REQUIRE_EQUAL(success(), voteproposal("bigvoter1111"_n, "bigvoter1111"_n, {"proposer1111"_n}));
 
     produce_blocks(1);
 
-    proposal = get_proposal("proposer1111"_n);
+    tally = get_proposal_tally("proposer1111"_n);
 
-    BOOST_REQUIRE_EQUAL(proposal["status"], 4);
+    BOOST_REQUIRE_EQUAL(tally["status"], 4);
+    BOOST_REQUIRE_EQUAL(get_proposal("proposer1111"_n)["status"], 4);
+    BOOST_REQUIRE_EQUAL(get_proposal("proposer1111"_n)["total_votes"].as_double(), tally["total_votes"].as_double());
 
     BOOST_REQUIRE_EQUAL(error("missing authority of reviewer1111"),
         approve("proposer1111"_n, "reviewer1111"_n, "proposer1111"_n));
@@ -645,9 +703,10 @@ core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
 
     produce_blocks(1);
 
-    proposal = get_proposal("proposer1111"_n);
+    tally = get_proposal_tally("proposer1111"_n);
 
-    BOOST_REQUIRE_EQUAL(proposal["status"], 5);
+    BOOST_REQUIRE_EQUAL(tally["status"], 5);
+    BOOST_REQUIRE_EQUAL(get_proposal("proposer1111"_n)["status"], 5);
 
     produce_blocks(1);
 
@@ -677,9 +736,9 @@ core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
 
     produce_blocks(1);
 
-    proposal = get_proposal("proposer1111"_n);
+    tally = get_proposal_tally("proposer1111"_n);
 
-    BOOST_REQUIRE_EQUAL(proposal["status"], 6);
+    BOOST_REQUIRE_EQUAL(tally["status"], 6);
 
     BOOST_REQUIRE_EQUAL(wasm_assert_msg("Proposal::status is not PROPOSAL_STATUS::APPROVED"), claimfunds("proposer1111"_n, "proposer1111"_n));
 
@@ -1051,8 +1110,9 @@ BOOST_FIXTURE_TEST_CASE(proposal_cleanvotes, eosio_wps_tester) try {
 
     produce_blocks(1);
 
-    BOOST_REQUIRE_EQUAL(error("missing authority of reviewer1111"), cleanvotes("proposer1111"_n, "reviewer1111"_n, "proposer1111"_n, 0, 1));
-    BOOST_REQUIRE_EQUAL(success(), cleanvotes("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, 0, 1));
+    BOOST_REQUIRE_EQUAL(error("missing authority of reviewer1111"), cleanvotes("proposer1111"_n, "reviewer1111"_n, "proposer1111"_n, name(), 1));
+    BOOST_REQUIRE_EQUAL(wasm_assert_msg("max must be greater than 0"), cleanvotes("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, name(), 0));
+    BOOST_REQUIRE_EQUAL("voter2222222"_n, cleanvotes_next("reviewer1111"_n, "proposer1111"_n, name(), 1));
 
     voter1111111 = get_wpsvoter("voter1111111"_n);
     voter2222222 = get_wpsvoter("voter2222222"_n);
@@ -1064,7 +1124,7 @@ BOOST_FIXTURE_TEST_CASE(proposal_cleanvotes, eosio_wps_tester) try {
 
     produce_blocks(1);
 
-    BOOST_REQUIRE_EQUAL(success(), cleanvotes("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, 1, 2));
+    BOOST_REQUIRE_EQUAL("voter3333333"_n, cleanvotes_next("reviewer1111"_n, "proposer1111"_n, "voter2222222"_n, 1));
 
     voter1111111 = get_wpsvoter("voter1111111"_n);
     voter2222222 = get_wpsvoter("voter2222222"_n);
@@ -1076,7 +1136,8 @@ BOOST_FIXTURE_TEST_CASE(proposal_cleanvotes, eosio_wps_tester) try {
 
     produce_blocks(1);
 
-    BOOST_REQUIRE_EQUAL(success(), cleanvotes("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, 0, 2));
+    // voters that no longer vote for the proposal are left as they are
+    BOOST_REQUIRE_EQUAL("voter3333333"_n, cleanvotes_next("reviewer1111"_n, "proposer1111"_n, name(), 2));
 
     voter1111111 = get_wpsvoter("voter1111111"_n);
     voter2222222 = get_wpsvoter("voter2222222"_n);
@@ -1088,7 +1149,7 @@ BOOST_FIXTURE_TEST_CASE(proposal_cleanvotes, eosio_wps_tester) try {
 
     produce_blocks(1);
 
-    BOOST_REQUIRE_EQUAL(success(), cleanvotes("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, 2, 3));
+    BOOST_REQUIRE_EQUAL(name(), cleanvotes_next("reviewer1111"_n, "proposer1111"_n, "voter3333333"_n, 10));
 
     voter1111111 = get_wpsvoter("voter1111111"_n);
     voter2222222 = get_wpsvoter("voter2222222"_n);
@@ -1099,4 +1160,143 @@ BOOST_FIXTURE_TEST_CASE(proposal_cleanvotes, eosio_wps_tester) try {
     BOOST_REQUIRE_EQUAL(voter3333333["proposals"].size(), 0);
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(proposal_voters_removed_with_proposal, eosio_wps_tester) try {
+
+    create_account_with_resources("committee111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+    create_account_with_resources("reviewer1111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10000.0000"));
+    create_account_with_resources("proposer1111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+
+    cross_15_percent_threshold();
+
+    setwpsenv(config::system_account_name, 35, 30, 500, 6);
+    regcommittee(config::system_account_name, "committee111"_n, "categoryX", true);
+    regreviewer("committee111"_n, "committee111"_n, "reviewer1111"_n, "bob", "bob");
+    regproposer("proposer1111"_n, "proposer1111"_n, "user", "one", "img_url", "bio", "country", "telegram", "website", "linkedin");
+    regproposal("proposer1111"_n, "proposer1111"_n, "committee111"_n, 1, "title", "summary", "project_img_url",
+    "description", "roadmap", 30, {"user"}, core_sym::from_string("9000.0000"), 3);
+    acceptprop("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n);
+
+
+    create_account_with_resources("voter1111111"_n, config::system_account_name, core_sym::from_string("10000.0000"), false, core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+    create_account_with_resources("voter2222222"_n, config::system_account_name, core_sym::from_string("10000.0000"), false, core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+    create_account_with_resources("voter3333333"_n, config::system_account_name, core_sym::from_string("10000.0000"), false, core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+
+    issue_and_transfer( "voter1111111", core_sym::from_string("100000000.0000"),  config::system_account_name );
+    BOOST_REQUIRE_EQUAL( success(), stake( "voter1111111", core_sym::from_string("50000000.0000"), core_sym::from_string("50000000.0000") ) );
+
+    issue_and_transfer( "voter2222222", core_sym::from_string("100000000.0000"),  config::system_account_name );
+    BOOST_REQUIRE_EQUAL( success(), stake( "voter2222222", core_sym::from_string("50000000.0000"), core_sym::from_string("50000000.0000") ) );
+
+    issue_and_transfer( "voter3333333", core_sym::from_string("100000000.0000"),  config::system_account_name );
+    BOOST_REQUIRE_EQUAL( success(), stake( "voter3333333", core_sym::from_string("50000000.0000"), core_sym::from_string("50000000.0000") ) );
+
+    // Make a producer account to create an appropriate producer_vote_weight
+    create_account_with_resources("prod11111111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+
+    // prod11111111 registers to be a producer
+    BOOST_REQUIRE_EQUAL( success(), regproducer( "prod11111111"_n, 1) );
+
+    BOOST_REQUIRE_EQUAL(success(), voteproposal("voter1111111"_n, "voter1111111"_n, {"proposer1111"_n}));
+    BOOST_REQUIRE_EQUAL(success(), voteproposal("voter2222222"_n, "voter2222222"_n, {"proposer1111"_n}));
+    BOOST_REQUIRE_EQUAL(success(), voteproposal("voter3333333"_n, "voter3333333"_n, {"proposer1111"_n}));
+
+
+    BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, "voter1111111"_n).is_null());
+    BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, "voter2222222"_n).is_null());
+    BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, "voter3333333"_n).is_null());
+
+    // stake changes update the tally but leave the proposal's voters alone
+    BOOST_REQUIRE_EQUAL( success(), stake( "voter1111111", core_sym::from_string("1.0000"), core_sym::from_string("1.0000") ) );
+    BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, "voter1111111"_n).is_null());
+
+    // withdrawing a vote removes the voter from the proposal's voters
+    BOOST_REQUIRE_EQUAL(success(), voteproposal("voter3333333"_n, "voter3333333"_n, {}));
+    BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, "voter3333333"_n).is_null());
+
+    BOOST_REQUIRE_EQUAL(success(), rejectprop("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, "reason"));
+
+    BOOST_REQUIRE_EQUAL(error("missing authority of reviewer1111"), rmvreject("proposer1111"_n, "reviewer1111"_n, "proposer1111"_n));
+    BOOST_REQUIRE_EQUAL(success(), rmvreject("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n));
+
+    BOOST_REQUIRE(get_proposal("proposer1111"_n).is_null());
+    BOOST_REQUIRE(get_proposal_tally("proposer1111"_n).is_null());
+    BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, "voter1111111"_n).is_null());
+    BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, "voter2222222"_n).is_null());
+    BOOST_REQUIRE_EQUAL(get_wpsvoter("voter1111111"_n)["proposals"].size(), 0);
+    BOOST_REQUIRE_EQUAL(get_wpsvoter("voter2222222"_n)["proposals"].size(), 0);
+    BOOST_REQUIRE_EQUAL(get_wpsvoter("voter3333333"_n)["proposals"].size(), 0);
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(proposal_voters_filled_for_old_votes, eosio_wps_tester) try {
+
+    create_account_with_resources("committee111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+    create_account_with_resources("reviewer1111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10000.0000"));
+    create_account_with_resources("proposer1111"_n, config::system_account_name, core_sym::from_string("100.0000"), false,
+    core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+
+    cross_15_percent_threshold();
+
+    // one more voter than `rmvreject` removes per action
+    const char* chars = "12345abcdefghijklmnopqrstuvwxyz"; // in name order
+    std::vector<name> voters;
+    for (uint32_t i = 0; i < 101; ++i) {
+        name voter(std::string("batchvoter") + chars[i / 31] + chars[i % 31]);
+        create_account_with_resources(voter, config::system_account_name, core_sym::from_string("10.0000"), false,
+        core_sym::from_string("10.0000"), core_sym::from_string("10.0000"));
+        transfer(config::system_account_name, voter, core_sym::from_string("10.0000"));
+        BOOST_REQUIRE_EQUAL( success(), stake( voter, core_sym::from_string("1.0000"), core_sym::from_string("1.0000") ) );
+        voters.push_back(voter);
+    }
+
+    // the votes are cast by a contract that has no `propvoters` index yet
+    deploy_system_v31_contract();
+    setwpsenv(config::system_account_name, 35, 30, 500, 6);
+    regcommittee(config::system_account_name, "committee111"_n, "categoryX", true);
+    regreviewer("committee111"_n, "committee111"_n, "reviewer1111"_n, "bob", "bob");
+    regproposer("proposer1111"_n, "proposer1111"_n, "user", "one", "img_url", "bio", "country", "telegram", "website", "linkedin");
+    regproposal("proposer1111"_n, "proposer1111"_n, "committee111"_n, 1, "title", "summary", "project_img_url",
+    "description", "roadmap", 30, {"user"}, core_sym::from_string("9000.0000"), 3);
+    acceptprop("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n);
+    for (const auto& voter : voters) {
+        BOOST_REQUIRE_EQUAL(success(), voteproposal(voter, voter, {"proposer1111"_n}));
+    }
+
+    deploy_contract(false);
+    produce_blocks(1);
+    BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, voters.front()).is_null());
+
+    BOOST_REQUIRE_EQUAL(wasm_assert_msg("max must be greater than 0"),
+                        push_action("alice1111111"_n, "fillpropvote"_n, mvo()("cursor", name())("max", 0)));
+    BOOST_REQUIRE_EQUAL(voters[60], fillpropvote_next(name(), 60));
+    BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, voters[59]).is_null());
+    BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, voters[60]).is_null());
+    BOOST_REQUIRE_EQUAL(name(), fillpropvote_next(voters[60], 60));
+    for (const auto& voter : voters) {
+        BOOST_REQUIRE(!get_proposal_voter("proposer1111"_n, voter).is_null());
+    }
+
+    BOOST_REQUIRE_EQUAL(success(), rejectprop("reviewer1111"_n, "reviewer1111"_n, "proposer1111"_n, "reason"));
+
+    // the votes are removed over two actions
+    BOOST_REQUIRE(!rmvreject_done("reviewer1111"_n, "proposer1111"_n));
+    BOOST_REQUIRE(!get_proposal("proposer1111"_n).is_null());
+    BOOST_REQUIRE_EQUAL(get_wpsvoter(voters.front())["proposals"].size(), 0);
+    BOOST_REQUIRE_EQUAL(get_wpsvoter(voters.back())["proposals"].size(), 1);
+    produce_blocks(1);
+    BOOST_REQUIRE(rmvreject_done("reviewer1111"_n, "proposer1111"_n));
+
+    BOOST_REQUIRE(get_proposal("proposer1111"_n).is_null());
+    BOOST_REQUIRE(get_proposal_tally("proposer1111"_n).is_null());
+    for (const auto& voter : voters) {
+        BOOST_REQUIRE(get_proposal_voter("proposer1111"_n, voter).is_null());
+        BOOST_REQUIRE_EQUAL(get_wpsvoter(voter)["proposals"].size(), 0);
+    }
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()